@@ -0,0 +1,118 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN sizeof(void *) // alignment of arena_alloc (enough for Nodes and LLs)
+
+/* a chunk of memory that allocations are bumped out of */
+typedef struct Chunk Chunk;
+
+struct Chunk {
+    Chunk *next; // older chunk
+    size_t size; // bytes in data
+    size_t used; // bytes handed out from data
+    char data[];
+};
+
+/* Arena (region allocator) definition. everything is freed at once by arena_delete */
+struct Arena {
+    size_t chunk; // default chunk size
+    size_t used; // bytes handed out (for stats)
+    size_t reserved; // bytes malloc'd for chunks (for stats)
+    Chunk *head; // newest chunk (allocations come from it)
+};
+
+/* constructor for an Arena that grabs memory chunk bytes at a time */
+Arena *arena_create(size_t chunk) {
+    Arena *a = (Arena *) malloc(sizeof(Arena));
+
+    if (a) {
+        a->chunk = chunk ? chunk : 1;
+        a->used = 0;
+        a->reserved = 0;
+        a->head = NULL;
+    }
+
+    return a;
+}
+
+/* destructor for an Arena. frees every allocation made from it */
+void arena_delete(Arena **a) {
+    if (a && *a) {
+        Chunk *c = (*a)->head;
+        while (c) {
+            Chunk *next = c->next;
+            free(c);
+            c = next;
+        }
+        free(*a);
+        *a = NULL;
+    }
+    return;
+}
+
+/* helper function that bumps size bytes aligned to align out of the newest chunk */
+static void *bump(Arena *a, size_t size, size_t align) {
+    if (!a)
+        return NULL;
+
+    Chunk *c = a->head;
+    size_t offset = c ? (c->used + align - 1) & ~(align - 1) : 0;
+
+    /* no room left: start a new chunk (big allocations get their own) */
+    if (!c || offset + size > c->size) {
+        size_t bytes = size > a->chunk ? size : a->chunk;
+        Chunk *fresh = (Chunk *) malloc(sizeof(Chunk) + bytes);
+        if (!fresh)
+            return NULL;
+
+        fresh->size = bytes;
+        fresh->used = 0;
+        a->reserved += bytes;
+
+        /* keep filling the current chunk if the big allocation got its own */
+        if (c && bytes > a->chunk) {
+            fresh->next = c->next;
+            c->next = fresh;
+            fresh->used = size;
+            a->used += size;
+            return fresh->data;
+        }
+
+        fresh->next = c;
+        a->head = c = fresh;
+        offset = 0;
+    }
+
+    c->used = offset + size;
+    a->used += size;
+    return c->data + offset;
+}
+
+/* allocates size bytes (pointer aligned) from the Arena */
+void *arena_alloc(Arena *a, size_t size) {
+    return bump(a, size, ALIGN);
+}
+
+/* copies length bytes of s into the Arena as a NUL terminated string */
+char *arena_strndup(Arena *a, const char *s, size_t length) {
+    char *copy = (char *) bump(a, length + 1, 1);
+    if (copy) {
+        memcpy(copy, s, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+/* returns the bytes handed out by the Arena */
+size_t arena_used(Arena *a) {
+    return a ? a->used : 0;
+}
+
+/* returns the bytes the Arena has reserved from malloc */
+size_t arena_reserved(Arena *a) {
+    return a ? a->reserved : 0;
+}
@@ -0,0 +1,20 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+typedef struct Arena Arena;
+
+Arena *arena_create(size_t chunk);
+
+void arena_delete(Arena **a);
+
+void *arena_alloc(Arena *a, size_t size);
+
+char *arena_strndup(Arena *a, const char *s, size_t length);
+
+size_t arena_used(Arena *a);
+
+size_t arena_reserved(Arena *a);
+
+#endif
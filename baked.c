@@ -0,0 +1,306 @@
+#include "baked.h"
+
+#include "hash.h"
+#include "ht.h"
+#include "node.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A baked dictionary is C source holding const tables, compiled into the
+ * binary (banhammer-static), so there is nothing to load or allocate at
+ * startup. its index is a minimal perfect hash built like PTHash: the words
+ * are put in buckets by their digest, and for each bucket (biggest first) a
+ * pilot is searched for that sends all its words to slots no other word took.
+ * a word's slot is then one hash of its digest and its bucket's pilot, and
+ * looking it up is one compare with the only word that can be there.
+ */
+
+#define BUCKET_WORDS 4 // words per bucket on average
+#define MAX_PILOT    (1u << 24) // pilots tried for a bucket before giving up
+#define PER_LINE     12 // numbers per line of the generated source
+
+/* nodes of the HT and their digests, collected for baking */
+typedef struct Words {
+    Node **nodes;
+    Digest *digests;
+    uint32_t count;
+    uint32_t size;
+    bool failed; // ran out of memory
+} Words;
+
+/* helper function that returns the bucket of a digest */
+static inline uint32_t bucket_of(const Digest *d, uint32_t buckets) {
+    return (uint32_t) (d->lo % buckets);
+}
+
+/* helper function that returns the slot a pilot sends a digest to (of n) */
+static inline uint32_t slot_of(const Digest *d, uint32_t pilot, uint32_t n) {
+    uint64_t h = d->hi ^ ((uint64_t) pilot * 0x9e3779b97f4a7c15);
+
+    /* murmur3's finalizer, so every pilot is a different permutation */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    return (uint32_t) (((h >> 32) * n) >> 32);
+}
+
+/* helper function that returns the fingerprint of a digest (bits used by neither of the above) */
+static inline uint32_t fingerprint_of(const Digest *d) {
+    return (uint32_t) (d->lo >> 32);
+}
+
+/* helper function for ht_foreach: adds a node to the Words array */
+static void collect(Node *n, void *arg) {
+    Words *all = (Words *) arg;
+
+    if (all->count == all->size) {
+        uint32_t size = all->size ? all->size * 2 : 1024;
+        Node **nodes = (Node **) realloc(all->nodes, size * sizeof(Node *));
+        if (!nodes) {
+            all->failed = true;
+            return;
+        }
+        all->nodes = nodes;
+        all->size = size;
+    }
+
+    all->nodes[all->count++] = n;
+    return;
+}
+
+/*
+ * helper function that finds the pilot of every bucket. order lists the
+ * words by bucket, first[b] is where bucket b starts in it. sets slots[i]
+ * to the slot of word i. returns false if a bucket has no pilot.
+ */
+static bool place(Words *all, uint32_t buckets, const uint32_t *order, const uint32_t *first,
+    uint32_t *pilots, uint32_t *slots) {
+    uint32_t n = all->count;
+    uint8_t *taken = (uint8_t *) calloc(n ? n : 1, sizeof(uint8_t));
+    uint32_t *by_size = (uint32_t *) malloc(buckets * sizeof(uint32_t));
+    uint32_t *counts = (uint32_t *) calloc(n + 2, sizeof(uint32_t));
+    bool ok = taken && by_size && counts;
+
+    /* the buckets from biggest to smallest (counting sort) */
+    for (uint32_t b = 0; ok && b < buckets; b++)
+        counts[n - (first[b + 1] - first[b])]++;
+    for (uint32_t s = 1; ok && s <= n + 1; s++)
+        counts[s] += counts[s - 1];
+    for (uint32_t b = buckets; ok && b-- > 0;)
+        by_size[--counts[n - (first[b + 1] - first[b])]] = b;
+
+    for (uint32_t k = 0; ok && k < buckets; k++) {
+        uint32_t b = by_size[k];
+        pilots[b] = 0;
+        if (first[b] == first[b + 1])
+            continue; // empty
+
+        /* try pilots until all the bucket's words land on free (and different) slots */
+        uint32_t pilot;
+        for (pilot = 0; pilot < MAX_PILOT; pilot++) {
+            uint32_t i;
+            for (i = first[b]; i < first[b + 1]; i++) {
+                uint32_t w = order[i], s = slot_of(&(all->digests[w]), pilot, n);
+                if (taken[s])
+                    break;
+                taken[s] = 1;
+                slots[w] = s;
+            }
+            if (i == first[b + 1])
+                break;
+
+            while (i-- > first[b]) // undo the words that did land
+                taken[slots[order[i]]] = 0;
+        }
+
+        pilots[b] = pilot;
+        ok = pilot < MAX_PILOT;
+    }
+
+    free(counts);
+    free(by_size);
+    free(taken);
+    return ok;
+}
+
+/* helper function that writes an array of numbers as C source */
+static void write_numbers(FILE *out, const char *decl, const uint32_t *v, uint32_t n) {
+    fprintf(out, "%s[%u] = {", decl, n ? n : 1);
+    for (uint32_t i = 0; i < n; i++)
+        fprintf(out, "%s%u,", i % PER_LINE ? " " : "\n    ", v[i]);
+    fprintf(out, n ? "\n};\n\n" : " 0 };\n\n");
+    return;
+}
+
+/*
+ * helper function that writes the bytes of a string (and its NUL) as C
+ * source, counting them in column. bytes past ASCII are written as escapes so
+ * they fit a char whether it is signed or not.
+ */
+static void write_string(FILE *out, const char *s, uint32_t *column) {
+    do {
+        uint8_t c = (uint8_t) *s;
+        fprintf(out, c < 0x80 ? "%s%u," : "%s'\\x%02x',", (*column)++ % PER_LINE ? " " : "\n    ", c);
+    } while (*s++);
+    return;
+}
+
+/*
+ * writes the dictionary in ht as C source to path, defining the Baked
+ * baked_dictionary. digests of the words are made with backend and salt.
+ * returns false if it cannot be written (or no perfect hash is found).
+ */
+bool baked_write(const char *path, HashTable *ht, HashBackend backend, uint64_t *salt) {
+    if (!path || !ht || !salt)
+        return false;
+
+    Words all = { NULL, NULL, 0, 0, false };
+    ht_foreach(ht, collect, &all);
+
+    uint32_t n = all.count, buckets = n / BUCKET_WORDS + 1;
+    Hasher *hasher = hasher_create(backend, salt);
+    all.digests = (Digest *) malloc((n ? n : 1) * sizeof(Digest));
+    uint32_t *first = (uint32_t *) calloc(buckets + 1, sizeof(uint32_t));
+    uint32_t *order = (uint32_t *) malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t *pilots = (uint32_t *) malloc(buckets * sizeof(uint32_t));
+    uint32_t *slots = (uint32_t *) malloc((n ? n : 1) * sizeof(uint32_t));
+    int32_t *at = (int32_t *) malloc((n ? n : 1) * sizeof(int32_t)); // word in each slot
+    bool ok = !all.failed && hasher && all.digests && first && order && pilots && slots && at;
+
+    /* the words by bucket (counting sort) */
+    for (uint32_t i = 0; ok && i < n; i++) {
+        all.digests[i] = hasher_digest(hasher, all.nodes[i]->oldspeak, all.nodes[i]->length);
+        first[bucket_of(&(all.digests[i]), buckets) + 1]++;
+    }
+    for (uint32_t b = 0; ok && b < buckets; b++)
+        first[b + 1] += first[b];
+    for (uint32_t i = 0; ok && i < n; i++) {
+        uint32_t b = bucket_of(&(all.digests[i]), buckets);
+        order[first[b]++] = i;
+    }
+    for (uint32_t b = buckets; ok && b > 0; b--) // back to where each bucket starts
+        first[b] = first[b - 1];
+    if (ok)
+        first[0] = 0;
+
+    ok = ok && place(&all, buckets, order, first, pilots, slots);
+    for (uint32_t i = 0; ok && i < n; i++)
+        at[slots[i]] = (int32_t) i;
+
+    FILE *out = ok ? fopen(path, "w") : NULL;
+    ok = ok && out;
+
+    if (ok) {
+        fprintf(out, "/* generated by banhammer -B from the word files, do not edit */\n\n");
+        fprintf(out, "#include \"baked.h\"\n\n");
+        write_numbers(out, "static const uint32_t pilots", pilots, buckets);
+
+        /* the entries in slot order, then their strings in the same order */
+        uint64_t pool = 0;
+        fprintf(out, "static const BakedEntry table[%u] = {", n ? n : 1);
+        for (uint32_t s = 0; s < n; s++) {
+            Node *w = all.nodes[at[s]];
+            uint64_t old_off = pool;
+            pool += w->length + 1;
+            uint64_t new_off = w->newspeak ? pool : BAKED_NONE;
+            if (w->newspeak)
+                pool += strlen(w->newspeak) + 1;
+            fprintf(out, "\n    { %u, %u, %" PRIu64 "u, %" PRIu64 "u },",
+                fingerprint_of(&(all.digests[at[s]])), w->length, old_off, new_off);
+        }
+        fprintf(out, n ? "\n};\n\n" : " { 0, 0, 0, 0 } };\n\n");
+        ok = pool < BAKED_NONE; // the strings are addressed with 32 bit offsets
+
+        uint32_t column = 0;
+        fprintf(out, "static const char strings[] = {");
+        for (uint32_t s = 0; s < n; s++) {
+            write_string(out, all.nodes[at[s]]->oldspeak, &column);
+            if (all.nodes[at[s]]->newspeak)
+                write_string(out, all.nodes[at[s]]->newspeak, &column);
+        }
+        fprintf(out, n ? "\n};\n\n" : " 0 };\n\n");
+
+        fprintf(out, "const Baked baked_dictionary = { %s, { 0x%" PRIx64 "ull, 0x%" PRIx64 "ull },\n",
+            backend == WYHASH ? "WYHASH" : "SPECK", salt[0], salt[1]);
+        fprintf(out, "    %u, %u, pilots, table, strings };\n", n, buckets);
+    }
+
+    if (out && fclose(out))
+        ok = false;
+    if (out && !ok)
+        remove(path);
+
+    free(at);
+    free(slots);
+    free(pilots);
+    free(order);
+    free(first);
+    free(all.digests);
+    free(all.nodes);
+    hasher_delete(&hasher);
+
+    return ok;
+}
+
+/* checks if the word with digest d may be in the dictionary (its slot's fingerprint) */
+bool baked_probe(const Baked *b, Digest *d) {
+    if (!b || !d || !b->entries)
+        return false;
+
+    uint32_t s = slot_of(d, b->pilots[bucket_of(d, b->buckets)], b->entries);
+    return b->table[s].fingerprint == fingerprint_of(d);
+}
+
+/* starts loading the pilot of the word with digest d into the cache (its slot depends on it) */
+void baked_prefetch(const Baked *b, Digest *d) {
+    if (b && d)
+        __builtin_prefetch(&(b->pilots[bucket_of(d, b->buckets)]));
+    return;
+}
+
+/*
+ * looks up oldspeak (length bytes, digest d). if found, sets old_out and
+ * new_out to its strings (new_out is NULL for badspeak). the seek is counted
+ * in stats (if not NULL): it never takes a link.
+ */
+bool baked_lookup(const Baked *b, Digest *d, const char *oldspeak, uint32_t length,
+    const char **old_out, const char **new_out, Stats *stats) {
+    if (!b || !d || !oldspeak)
+        return false;
+
+    if (stats)
+        stats->seeks++;
+
+    if (!b->entries)
+        return false;
+
+    const BakedEntry *e = &(b->table[slot_of(d, b->pilots[bucket_of(d, b->buckets)], b->entries)]);
+    if (e->fingerprint != fingerprint_of(d) || e->length != length
+        || memcmp(b->strings + e->oldspeak, oldspeak, length))
+        return false;
+
+    *old_out = b->strings + e->oldspeak;
+    *new_out = e->newspeak == BAKED_NONE ? NULL : b->strings + e->newspeak;
+    return true;
+}
+
+/* returns the bytes of the baked tables (for stats) */
+size_t baked_bytes(const Baked *b) {
+    if (!b)
+        return 0;
+
+    size_t bytes = (size_t) b->buckets * sizeof(uint32_t) + (size_t) b->entries * sizeof(BakedEntry);
+    for (uint32_t i = 0; i < b->entries; i++) {
+        const BakedEntry *e = &(b->table[i]);
+        bytes += e->length + 1;
+        if (e->newspeak != BAKED_NONE)
+            bytes += strlen(b->strings + e->newspeak) + 1;
+    }
+    return bytes;
+}
@@ -0,0 +1,48 @@
+#ifndef __BAKED_H__
+#define __BAKED_H__
+
+#include "hash.h"
+#include "ht.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BAKED_NONE UINT32_MAX // newspeak offset of a badspeak word
+
+/* a word of a baked dictionary (offsets are into its strings) */
+typedef struct BakedEntry {
+    uint32_t fingerprint; // bits of the word's digest that do not pick its slot
+    uint32_t length; // of oldspeak
+    uint32_t oldspeak;
+    uint32_t newspeak; // BAKED_NONE for badspeak
+} BakedEntry;
+
+/*
+ * a dictionary compiled into C source by baked_write: a minimal perfect hash
+ * over the words' digests (a pilot per bucket of words picks the slots of the
+ * bucket's words), so a word has exactly one slot to compare with.
+ */
+typedef struct Baked {
+    HashBackend backend;
+    uint64_t salt[2]; // of the hasher the digests are made with
+    uint32_t entries; // words (and slots)
+    uint32_t buckets; // pilots
+    const uint32_t *pilots;
+    const BakedEntry *table;
+    const char *strings; // NUL terminated words
+} Baked;
+
+bool baked_write(const char *path, HashTable *ht, HashBackend backend, uint64_t *salt);
+
+bool baked_probe(const Baked *b, Digest *d);
+
+void baked_prefetch(const Baked *b, Digest *d);
+
+bool baked_lookup(const Baked *b, Digest *d, const char *oldspeak, uint32_t length,
+    const char **old_out, const char **new_out, Stats *stats);
+
+size_t baked_bytes(const Baked *b);
+
+#endif
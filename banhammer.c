@@ -1,28 +1,85 @@
+#include "arena.h"
+#include "baked.h"
 #include "bf.h"
 #include "bv.h"
+#include "collector.h"
+#include "dict.h"
+#include "filter.h"
+#include "hash.h"
 #include "ht.h"
+#include "input.h"
+#include "live.h"
 #include "ll.h"
 #include "messages.h"
+#include "normalize.h"
 #include "parser.h"
+#include "phrases.h"
+#include "record.h"
+#include "server.h"
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-/* max size of a word from badspeak and newspeak file words (see design) */
-#define MAX_WORD 4096 // max word size is 4096 (newspeak and badspeak words are capped at 28)
+#define CHUNK_BYTES (1 << 20) // stdin bytes scanned at a time
+#define ROUND_BYTES (16 << 20) // stdin bytes scanned per thread per round with -j
+#define HISTOGRAM_BINS 16 // chain lengths counted for -J (the last bin counts the longer ones)
+#define RECORD_FIELD "text" // field of a JSON line that is filtered with -R jsonl
 
-/* 
- * valid regex pattern (to be compiled later):
- * [a-zA-Z0-9_]		:	word can start from this set
- * ([-']?[a-zA-Z0-9_])*	:	character group that must follow the valid beginning set
- * [-']?		:	the set can be followed by either at most one continuous - or '
- * [a-zA-Z0-9_]		:	which indeed must be followed by the valid set again (to avoid -- or '')
- * (group)*		:	do this zero or more times (to include single letters and multiple-hypens-too)
- */
-#define PATTERN "[a-zA-Z0-9_]+([-']?[a-zA-Z0-9_])*"
+#ifdef BANHAMMER_STATIC
+extern const Baked baked_dictionary; // dictionary.c, made by banhammer -B (see the Makefile)
+#endif
+
+/* one thread's share of a round of input with -j */
+typedef struct Job {
+    Filter *filter; // the thread's own (over the shared dict)
+    const char *text; // whole words of input
+    uint64_t size;
+    const char *round; // the round's input before text (the phrases that start there go on into it)
+    uint64_t offset; // bytes of it
+    bool ok; // false if out of memory
+} Job;
+
+/* what -s reports besides the counters: the time of the stages and the memory of the filtering */
+typedef struct Run {
+    bool json; // -J
+    uint64_t load_wall; // building or mapping the dictionary (ns)
+    uint64_t load_cpu;
+    uint64_t filter_wall; // filtering the input, on all threads (ns)
+    uint64_t filter_cpu;
+    size_t filter_bytes; // the Filters
+    uint64_t input_bytes; // stdin's read buffer
+    uint64_t input_mapped; // and mapping
+} Run;
+
+/* how to build the dictionary again when it is reloaded with -r */
+typedef struct Reload {
+    uint32_t ht_len;
+    uint32_t bf_len;
+    bool mtf;
+    bool open;
+    bool blocked;
+    HashBackend backend;
+    const char *snapshot_path; // reopened instead of the word files if not NULL
+    bool counting; // counting BF, so words can be removed (-e)
+    bool automaton; // a Dafsa instead of the BF and HT (-a)
+    bool normalize; // index the words by their canonical forms (-n)
+} Reload;
+
+/* how far the edit log of -e has been applied to the live dictionary */
+typedef struct Edits {
+    const char *path;
+    uint64_t version; // live version the log was applied to
+    dev_t dev; // the log file (replaying starts over when it is replaced)
+    ino_t ino;
+    off_t applied; // bytes of the log applied so far
+} Edits;
 
 /* helper function to print usage */
 static void usage(char *argv) {
@@ -32,213 +89,1115 @@ static void usage(char *argv) {
         "  Filters out and reports bad words parsed from stdin.\n"
         "\n"
         "USAGE\n"
-        "  %s [-hsm] [-t size] [-f size]\n"
+        "  %s [-hsJmboan] [-t size] [-f size] [-H hash] [-c snapshot | -d snapshot | -B source]\n"
+        "     [-j threads]\n"
+        "  %s [-sJmboan] [-t size] [-f size] [-H hash] [-d snapshot] [-j threads] -u socket\n"
+        "  %s [-sJmboan] [-t size] [-f size] [-H hash] [-d snapshot | -e edits] -r\n"
+        "  %s [-sJmboan] [-t size] [-f size] [-H hash] [-d snapshot] -R format\n"
         "\n"
         "OPTIONS\n"
         "  -h           Program usage and help.\n"
         "  -s           Print program statistics.\n"
-        "  -m           Enable move-to-front rule.\n"
-        "  -t size      Specify hash table size (default: 10000).\n"
-        "  -f size      Specify Bloom filter size (default: 2^20).\n",
-        argv);
+        "  -J           Print more statistics, as JSON (implies -s).\n"
+        "  -m           Enable move-to-front rule (with one thread only).\n"
+        "  -b           Use a cache-line-blocked Bloom filter.\n"
+        "  -o           Use an open addressing hash table.\n"
+        "  -a           Use a minimized word automaton (DAFSA) instead of the Bloom\n"
+        "               filter and hash table: words are walked byte by byte and\n"
+        "               rejected at the first byte no dictionary word has there.\n"
+        "  -n           Also match obfuscated spellings of the words (b4d, baaaad,\n"
+        "               b.a.d): words are mapped through the substitutions of\n"
+        "               leetspeak.txt (default: the usual ones), with runs of a\n"
+        "               letter collapsed, and looked up by that canonical form.\n"
+        "  -t size      Specify initial hash table size (default: 10000).\n"
+        "  -f size      Specify Bloom filter size (default: 2^20).\n"
+        "  -H hash      Hash backend: speck or wyhash (default: speck).\n"
+        "  -c snapshot  Compile the word files into a snapshot and exit.\n"
+        "  -B source    Compile the word files into C source and exit (the\n"
+        "               dictionary of banhammer-static, see the Makefile).\n"
+        "  -d snapshot  Filter with a compiled snapshot instead of the word files\n"
+        "               (-t, -f, -H, -b and -o are taken from the snapshot).\n"
+        "  -j threads   Filter stdin with this many threads (default: 1).\n"
+        "  -u socket    Serve requests on this Unix domain socket until interrupted\n"
+        "               instead of filtering stdin (-j sets the number of workers,\n"
+        "               -s prints the statistics of every request at exit).\n"
+        "  -r           Filter stdin as a stream, printing the transgressions as\n"
+        "               they are found, and reload the word files (with -n and\n"
+        "               leetspeak.txt, or the -d snapshot) on SIGHUP or when\n"
+        "               they change.\n"
+        "  -e edits     With -r, apply the lines appended to this file to the\n"
+        "               dictionary as they are written: +word adds badspeak,\n"
+        "               +oldspeak newspeak adds a translation, -word removes\n"
+        "               a word (the Bloom filter counts, so removing is exact).\n"
+        "  -R format    Filter stdin as records (line, nul or jsonl: JSON lines\n"
+        "               with a \"text\" field), printing one verdict line per\n"
+        "               record: its number, none, thoughtcrime, rightcrime,\n"
+        "               mixspeak or invalid, and its transgressions.\n",
+        argv, argv, argv, argv);
+#ifdef BANHAMMER_STATIC
+    fprintf(stdout,
+        "\n"
+        "  This binary filters with the dictionary compiled into it, so -c, -B, -d,\n"
+        "  -r, -e, -n and the options that build the dictionary (-a, -t, -f, -o,\n"
+        "  -b, -H) are rejected.\n");
+#endif
 }
 
 /* helper functions that frees mem if error occurs in main */
-static void main_err(BitVector *args, HashTable *ht, BloomFilter *bf) {
+static void main_err(BitVector *args, HashTable *ht, BloomFilter *bf, Hasher *hasher, Dict *dict) {
     if (args)
         bv_delete(&args);
+    if (dict)
+        dict_delete(&dict);
+    if (hasher)
+        hasher_delete(&hasher);
     if (ht)
         ht_delete(&ht);
     if (bf)
         bf_delete(&bf);
 }
 
+/* helper function that case folds a dictionary word into folded the way the input's words are */
+static void fold_word(const char *word, char *folded) {
+    uint32_t length = words_fold(folded, word, (uint32_t) strlen(word));
+    folded[length] = '\0';
+    return;
+}
+
+/*
+ * helper function that reads a quoted entry whose first token is word (up to
+ * the closing quote, which may be in word already) into text, without the
+ * quotes. text may be word. returns its length.
+ */
+static uint32_t read_quoted(FILE *infile, const char *word, char *text) {
+    const char *close = strchr(word + 1, '"');
+    uint32_t length = close ? (uint32_t) (close - word - 1) : (uint32_t) strlen(word + 1);
+    memmove(text, word + 1, length);
+
+    for (int c; !close && (c = fgetc(infile)) != EOF && c != '"';)
+        if (length < MAX_WORD - 1)
+            text[length++] = (char) c;
+
+    text[length] = '\0';
+    return length;
+}
+
+/* helper function that reads the newspeak of an oldspeak: a token or a quoted entry (empty at eof) */
+static void read_newspeak(FILE *infile, char *new_speak) {
+    if (fscanf(infile, "%4095s", new_speak) == EOF)
+        new_speak[0] = '\0';
+    else if (new_speak[0] == '"')
+        read_quoted(infile, new_speak, new_speak);
+    return;
+}
+
 /* helper function to either readin the badspeak file or oldspeak newspeak pair */
-static void read_file(FILE *infile, HashTable *ht, BloomFilter *bf, bool is_badfile) {
-    char old_speak[MAX_WORD];
+/* ("quoted words" are a phrase, and a quoted newspeak may have spaces too) */
+/* (the words are indexed by their canonical form too if normalizer is not NULL) */
+/* (returns false if out of memory for the phrases or the index) */
+static bool read_file(FILE *infile, HashTable *ht, BloomFilter *bf, Hasher *hasher,
+    Phrases *phrases, Normalizer *normalizer, bool is_badfile) {
+    char word[MAX_WORD];
+    char old_speak[WORDS_FOLDED(MAX_WORD)];
     char new_speak[MAX_WORD];
+    char phrase[MAX_WORD + WORDS_PADDING]; // scanned for its words
+    bool ok = true;
+
+    /* read in each word till eof (folded, since the input's words are) */
+    while (ok && fscanf(infile, "%4095s", word) != EOF) {
+        if (word[0] == '"') {
+            uint32_t length = read_quoted(infile, word, phrase);
+            if (!is_badfile)
+                read_newspeak(infile, new_speak);
+            ok = phrases_add(phrases, phrase, length, is_badfile ? NULL : new_speak);
+            continue;
+        }
 
-    /* read in each word till eof */
-    while (fscanf(infile, "%s", old_speak) != EOF) {
-        bf_insert(bf, old_speak); // add to BF
+        fold_word(word, old_speak);
+        Digest d = hasher_digest(hasher, old_speak, strlen(old_speak)); // hashed once for bf and ht
+        bf_insert(bf, &d); // add to BF
+        if (normalizer)
+            ok = normalizer_add(normalizer, old_speak, (uint32_t) strlen(old_speak));
 
         /* file is badspeak, only add oldspeak to ht */
         if (is_badfile)
-            ht_insert(ht, old_speak, NULL); // add to HT (no newspeak yet)
+            ht_insert(ht, &d, old_speak, NULL); // add to HT (no newspeak yet)
 
         /* file is oldspeak, get newspeak and add the pair to ht */
         else {
-            fscanf(infile, "%s", new_speak);
-            ht_insert(ht, old_speak, new_speak);
+            read_newspeak(infile, new_speak);
+            ht_insert(ht, &d, old_speak, new_speak);
         }
     }
 
     fclose(infile); // done with file
 
+    return ok;
+}
+
+/*
+ * helper function that reads the substitutions of leetspeak.txt into z, or
+ * sets the usual ones if there is no such file. a line is a character and
+ * the letter it stands for (4 a), or a character alone to drop it (.).
+ * returns false if a line is not valid.
+ */
+static bool read_table(Normalizer *z) {
+    FILE *table = fopen("leetspeak.txt", "r");
+    if (!table) {
+        normalizer_defaults(z);
+        return true;
+    }
+
+    char line[MAX_WORD];
+    char from[3], to[3], rest[2];
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), table)) {
+        int fields = sscanf(line, "%2s %2s %1s", from, to, rest);
+        if (fields < 1)
+            continue; // blank line
+        ok = fields < 3 && !from[1] && (fields == 1 || !to[1])
+             && normalizer_map(z, from[0], fields == 2 ? to[0] : '\0');
+    }
+
+    fclose(table);
+    return ok;
+}
+
+/* helper function that applies one line of the edit log to dict (see apply_edits) */
+static void apply_edit(Dict *dict, const char *line) {
+    char word[MAX_WORD];
+    char old_speak[WORDS_FOLDED(MAX_WORD)];
+    char new_speak[MAX_WORD];
+
+    int words = sscanf(line + 1, "%4095s %4095s", word, new_speak);
+    if (words < 1)
+        return; // blank or unknown lines are skipped
+    fold_word(word, old_speak);
+
+    if (line[0] == '+')
+        dict_add(dict, old_speak, words == 2 ? new_speak : NULL);
+    else if (line[0] == '-')
+        dict_remove(dict, old_speak);
+    return;
+}
+
+/*
+ * applies the complete lines appended to the edit log since the last call
+ * to dict, the version-th of the live dictionary, so each edit costs O(1)
+ * whatever the size of the dictionary. the whole log is replayed onto a new
+ * version (rebuilt from the word files), or when the log is replaced or
+ * truncated. a line still being written is left for the next call.
+ */
+static void apply_edits(Dict *dict, uint64_t version, Edits *e) {
+    struct stat st;
+    if (stat(e->path, &st))
+        return; // no log (yet)
+
+    if (version != e->version || st.st_dev != e->dev || st.st_ino != e->ino
+        || st.st_size < e->applied) {
+        e->version = version;
+        e->dev = st.st_dev;
+        e->ino = st.st_ino;
+        e->applied = 0;
+    }
+
+    if (st.st_size == e->applied)
+        return; // nothing new
+
+    FILE *log = fopen(e->path, "r");
+    if (!log)
+        return;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+
+    if (!fseeko(log, e->applied, SEEK_SET)) {
+        while ((n = getline(&line, &cap, log)) > 0 && line[n - 1] == '\n') {
+            apply_edit(dict, line);
+            e->applied += n;
+        }
+    }
+
+    free(line);
+    fclose(log);
     return;
 }
 
-/* helper function to lower charecter [A-Z] */
-static inline char lower_char(uint8_t c) {
-    return (c >= 'A' && c <= 'Z') ? c + 32 : c; // upper-lower diff = 32
+/* thread function for -j: filters the words of job->text with the job's filter */
+static void *filter_job(void *arg) {
+    Job *job = (Job *) arg;
+    filter_prime(job->filter, job->round, job->offset);
+    job->ok = filter_text(job->filter, job->text, job->size);
+    return NULL;
 }
 
-/* helper function to make a string lowercase (wrapper around tolower) */
-static void lower_str(char *str) {
-    uint64_t i = 0;
-    char c;
-    while ((c = str[i]) != '\0') { // until end-of-line
-        str[i] = lower_char(c); // lower each char
-        i++;
+/* filters the input on this thread. returns false if out of memory */
+static bool filter_serial(Filter *f, Input *in) {
+    const char *text; // chunk of the input
+    uint64_t size;
+
+    while ((text = input_next(in, CHUNK_BYTES, &size)) != NULL) {
+        if (!filter_text(f, text, size))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * filters the input with jobs threads. it is read in rounds that are split
+ * into one chunk of whole words per thread. each thread has its own Filter
+ * (the dict is only read); they are merged into f in input order, so the
+ * transgressions (and their order) are the same as when filtering with one
+ * thread (each thread first looks through the words before its chunk for
+ * the phrases that start there). the threads are timed (and their memory
+ * counted) into run if it is not NULL.
+ */
+static bool filter_parallel(Filter *f, Dict *dict, Input *in, uint32_t jobs, Run *run) {
+    Job *job = (Job *) calloc(jobs, sizeof(Job));
+    pthread_t *threads = (pthread_t *) malloc(jobs * sizeof(pthread_t));
+    bool *started = (bool *) malloc(jobs * sizeof(bool)); // false if the job ran on this thread
+
+    bool ok = job && threads && started;
+    for (uint32_t j = 0; ok && j < jobs; j++) {
+        ok = (job[j].filter = filter_create(dict)) != NULL;
+        filter_time(job[j].filter, run != NULL);
+    }
+
+    const char *text;
+    uint64_t size;
+    const bool *inner = normalizer_joiners(dict_normalizer(dict)); // (no chunk ends inside b.a.d)
+
+    while (ok && (text = input_next(in, (uint64_t) ROUND_BYTES * jobs, &size)) != NULL) {
+
+        /* one chunk of whole words per thread */
+        uint64_t begin = 0;
+        for (uint32_t j = 0; j < jobs; j++) {
+            uint64_t end = size;
+            if (j + 1 < jobs) {
+                end = size / jobs * (j + 1);
+                end = end <= begin ? begin : begin + words_split(text + begin, end - begin, inner);
+            }
+
+            job[j].text = text + begin;
+            job[j].size = end - begin;
+            job[j].round = text;
+            job[j].offset = begin;
+            begin = end;
+
+            /* from where the last round ended (f has the last chunk's phrases merged in) */
+            filter_follow(job[j].filter, f);
+        }
+
+        /* filter the chunks (on this thread if no thread can be started) */
+        for (uint32_t j = 0; j < jobs; j++) {
+            started[j] = !pthread_create(&threads[j], NULL, filter_job, &job[j]);
+            if (!started[j])
+                filter_job(&job[j]);
+        }
+
+        /* merge the results in input order */
+        for (uint32_t j = 0; j < jobs; j++) {
+            if (started[j])
+                pthread_join(threads[j], NULL);
+
+            ok = ok && job[j].ok && filter_merge(f, job[j].filter);
+            filter_reset(job[j].filter);
+        }
+    }
+
+    for (uint32_t j = 0; job && j < jobs; j++) {
+        if (run)
+            run->filter_bytes += filter_bytes(job[j].filter);
+        filter_delete(&(job[j].filter));
+    }
+    free(started);
+    free(threads);
+    free(job);
+
+    return ok;
+}
+
+/*
+ * filters the input as a stream against the live dictionary (see live.h). the
+ * transgressions of every chunk are printed as soon as it is filtered, so the
+ * filter holds nothing of a version between chunks (but the phrases in
+ * progress, which filter_use drops if it changes) and a reload is used from
+ * the next chunk on. new edits (if not NULL) are applied before each chunk,
+ * when nothing points into the dictionary. the counters are added to total.
+ * returns false if out of memory.
+ */
+static bool filter_stream(Filter *f, Live *live, Input *in, Edits *edits, bool quiet, Stats *total) {
+    const char *text; // chunk of the input
+    uint64_t size;
+
+    /* no chunk ends inside b.a.d: the first is cut for the version there is now, each next one for its chunk's */
+    input_join(in, normalizer_joiners(dict_normalizer(live_enter(live, 0))));
+    live_exit(live, 0);
+
+    while ((text = input_next(in, CHUNK_BYTES, &size)) != NULL) {
+        Dict *dict = live_enter(live, 0);
+        if (edits)
+            apply_edits(dict, live_version(live), edits);
+
+        filter_use(f, dict);
+        input_join(in, normalizer_joiners(dict_normalizer(dict)));
+        bool ok = filter_text(f, text, size);
+
+        if (ok && !quiet) {
+            collector_print(filter_badspeak(f));
+            collector_print(filter_rightspeak(f));
+            fflush(stdout);
+        }
+
+        stats_add(total, filter_stats(f));
+        filter_clear(f); // the next chunk goes on with the phrases in progress
+        live_exit(live, 0);
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+/* helper function that prints the words of a Collector on a verdict line (see filter_records) */
+static void print_words(Collector *c) {
+    for (uint32_t i = 0; i < collector_count(c); i++) {
+        Match *m = collector_get(c, i);
+        fputc(' ', stdout);
+        fputs(m->oldspeak, stdout);
+        if (m->newspeak) {
+            fputs("->", stdout);
+            fputs(m->newspeak, stdout);
+        }
     }
     return;
 }
 
+/*
+ * filters the input as records (-R), printing one verdict line per record:
+ * its number (from 1), its verdict and its transgressions. the dictionary
+ * and the Filter are kept from one record to the next, and resetting the
+ * Filter only touches the words a record used, so a record costs its own
+ * words and nothing more. the counters are added to total. returns false if
+ * out of memory.
+ */
+static bool filter_records(Filter *f, Input *in, RecordFormat format, bool quiet, Stats *total) {
+    const char *text; // chunk of the input (whole records)
+    uint64_t size, number = 0;
+    char *decoded = NULL; // text of a JSON line with escapes
+    uint64_t capacity = 0;
+    bool ok = true;
+
+    input_delimit(in, record_delimiter(format));
+
+    while (ok && (text = input_next(in, CHUNK_BYTES, &size)) != NULL) {
+        Records r;
+        const char *record;
+        uint64_t length;
+
+        records_init(&r, text, size, record_delimiter(format));
+        while (ok && (record = records_next(&r, &length)) != NULL) {
+            number++;
+
+            /* only the text field of a JSON line is filtered */
+            if (format == RECORD_JSONL) {
+                if (length + WORDS_PADDING > capacity) {
+                    char *bigger = (char *) realloc(decoded, length + WORDS_PADDING);
+                    if (!bigger) {
+                        ok = false;
+                        break;
+                    }
+                    decoded = bigger;
+                    capacity = length + WORDS_PADDING;
+                }
+
+                record = record_json_text(record, length, RECORD_FIELD, decoded, &length);
+                if (!record) {
+                    if (!quiet)
+                        fprintf(stdout, "%" PRIu64 " invalid\n", number);
+                    continue;
+                }
+            }
+
+            /* a record ends at its delimiter (or the text's end), so between words */
+            ok = filter_text(f, record, length);
+
+            Collector *bad = filter_badspeak(f);
+            Collector *right = filter_rightspeak(f);
+            if (ok && !quiet) {
+                bool thoughtcrime = collector_count(bad) > 0, rightcrime = collector_count(right) > 0;
+                fprintf(stdout, "%" PRIu64 " %s", number,
+                    thoughtcrime ? (rightcrime ? "mixspeak" : "thoughtcrime")
+                                 : (rightcrime ? "rightcrime" : "none"));
+                print_words(bad);
+                print_words(right);
+                fputc('\n', stdout);
+            }
+
+            stats_add(total, filter_stats(f));
+            filter_reset(f);
+        }
+    }
+
+    free(decoded);
+    return ok;
+}
+
+/* helper function that names the layout of the BF (baked dicts have a fingerprint per word instead) */
+static const char *layout(Dict *dict) {
+    BloomFilter *bf = dict_bf(dict);
+    return dict_dafsa(dict) ? "none" : !bf ? "fingerprint" : bf_blocked(bf) ? "blocked" : "standard";
+}
+
+/* helper function that returns the expected false positive rate of the BF (or of a 32 bit fingerprint) */
+static double expected_fp_rate(Dict *dict) {
+    return dict_baked(dict) ? 1.0 / 4294967296.0 : bf_fp_rate(dict_bf(dict));
+}
+
+/* helper function that prints a ratio for JSON (which has no NaN) */
+static double ratio(double a, double b) {
+    return b ? a / b : 0.0;
+}
+
+/*
+ * helper function that prints the statistics as JSON (-J): the counters of
+ * every stage, the chain lengths of the HT, the bytes held by each structure
+ * and the wall/cpu time of each stage (tokenize and probe are summed over the
+ * threads and have no cpu time of their own: they share filter's).
+ */
+static void print_json(Dict *dict, Stats *stats, Run *run) {
+    uint64_t wall = stats_clock(CLOCK_MONOTONIC), cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+
+    HashTable *ht = dict_ht(dict); // NULL when filtering with a snapshot, baked tables or an automaton
+    BloomFilter *bf = dict_bf(dict); // NULL when baked or an automaton
+    Snapshot *s = dict_snapshot(dict);
+    const Baked *b = dict_baked(dict);
+    uint64_t bins[HISTOGRAM_BINS];
+    uint32_t bf_bytes = 0;
+
+    ht_histogram(ht, bins, HISTOGRAM_BINS);
+    bf_data(bf, &bf_bytes);
+    uint64_t negatives = stats->probes - (stats->passes - stats->false_positives);
+
+    wall = stats_clock(CLOCK_MONOTONIC) - wall; // putting the report together
+    cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+    fprintf(stdout, "{\n");
+    fprintf(stdout, "  \"words\": %" PRIu64 ",\n", stats->words);
+    fprintf(stdout, "  \"seeks\": %" PRIu64 ",\n", stats->seeks);
+    fprintf(stdout, "  \"average_seek_length\": %0.6lf,\n", ratio(stats->links, stats->seeks));
+    fprintf(stdout, "  \"bloom_filter\": {\n");
+    fprintf(stdout, "    \"layout\": \"%s\",\n", layout(dict));
+    fprintf(stdout, "    \"size\": %u,\n", bf_size(bf));
+    fprintf(stdout, "    \"load\": %0.6lf,\n", ratio(bf_count(bf), bf_size(bf)));
+    fprintf(stdout, "    \"probes\": %" PRIu64 ",\n", stats->probes);
+    fprintf(stdout, "    \"rejections\": %" PRIu64 ",\n", stats->probes - stats->passes);
+    fprintf(stdout, "    \"passes\": %" PRIu64 ",\n", stats->passes);
+    fprintf(stdout, "    \"false_positives\": %" PRIu64 ",\n", stats->false_positives);
+    fprintf(stdout, "    \"false_positive_rate\": %0.8lf,\n",
+        ratio(stats->false_positives, negatives));
+    fprintf(stdout, "    \"expected_false_positive_rate\": %0.8lf\n", expected_fp_rate(dict));
+    fprintf(stdout, "  },\n");
+
+    if (ht) {
+        fprintf(stdout, "  \"hash_table\": {\n");
+        fprintf(stdout, "    \"engine\": \"%s\",\n", ht_open_addressing(ht) ? "open" : "chained");
+        fprintf(stdout, "    \"size\": %u,\n", ht_size(ht));
+        fprintf(stdout, "    \"entries\": %u,\n", ht_entries(ht));
+        fprintf(stdout, "    \"load\": %0.6lf,\n", ratio(ht_count(ht), ht_size(ht)));
+        fprintf(stdout, "    \"mtf_moves\": %" PRIu64 ",\n", stats->moves);
+        fprintf(stdout, "    \"chain_lengths\": [");
+        for (uint32_t i = 0; i < HISTOGRAM_BINS; i++)
+            fprintf(stdout, "%s%" PRIu64, i ? ", " : "", bins[i]);
+        fprintf(stdout, "]\n  },\n");
+    } else if (dict_dafsa(dict)) {
+        Dafsa *a = dict_dafsa(dict);
+        fprintf(stdout, "  \"automaton\": {\n");
+        fprintf(stdout, "    \"entries\": %u,\n", dafsa_entries(a));
+        fprintf(stdout, "    \"states\": %u,\n", dafsa_states(a));
+        fprintf(stdout, "    \"edges\": %u\n", dafsa_edges(a));
+        fprintf(stdout, "  },\n");
+    } else if (b) {
+        fprintf(stdout, "  \"baked\": {\n");
+        fprintf(stdout, "    \"buckets\": %u,\n", b->buckets);
+        fprintf(stdout, "    \"entries\": %u\n", b->entries);
+        fprintf(stdout, "  },\n");
+    } else {
+        fprintf(stdout, "  \"snapshot\": {\n");
+        fprintf(stdout, "    \"size\": %u,\n", snapshot_size(s));
+        fprintf(stdout, "    \"entries\": %u,\n", snapshot_entries(s));
+        fprintf(stdout, "    \"load\": %0.6lf\n", ratio(snapshot_entries(s), snapshot_size(s)));
+        fprintf(stdout, "  },\n");
+    }
+
+    Phrases *p = dict_phrases(dict); // NULL without phrases (zeros)
+    fprintf(stdout, "  \"phrases\": {\n");
+    fprintf(stdout, "    \"count\": %u,\n", phrases_count(p));
+    fprintf(stdout, "    \"tokens\": %u,\n", phrases_tokens(p));
+    fprintf(stdout, "    \"states\": %u,\n", phrases_states(p));
+    fprintf(stdout, "    \"longest\": %u\n", phrases_longest(p));
+    fprintf(stdout, "  },\n");
+
+    Normalizer *z = dict_normalizer(dict); // NULL without -n (zeros)
+    fprintf(stdout, "  \"canonical\": {\n");
+    fprintf(stdout, "    \"forms\": %u,\n", normalizer_count(z));
+    fprintf(stdout, "    \"substitutions\": %u,\n", normalizer_rules(z));
+    fprintf(stdout, "    \"obfuscated_words\": %" PRIu64 "\n", stats->normalized);
+    fprintf(stdout, "  },\n");
+
+    fprintf(stdout, "  \"peak_bytes\": {\n");
+    fprintf(stdout, "    \"bloom_filter\": %u,\n", s ? 0 : bf_bytes); // mapped with the snapshot
+    fprintf(stdout, "    \"hash_table\": %zu,\n", ht_bytes(ht));
+    fprintf(stdout, "    \"snapshot\": %zu,\n", snapshot_bytes(s));
+    fprintf(stdout, "    \"baked\": %zu,\n", baked_bytes(b));
+    fprintf(stdout, "    \"automaton\": %zu,\n", dafsa_bytes(dict_dafsa(dict)));
+    fprintf(stdout, "    \"phrases\": %zu,\n", phrases_bytes(p));
+    fprintf(stdout, "    \"canonical\": %zu,\n", normalizer_bytes(z));
+    fprintf(stdout, "    \"filters\": %zu,\n", run->filter_bytes);
+    fprintf(stdout, "    \"input_buffer\": %" PRIu64 ",\n", run->input_bytes);
+    fprintf(stdout, "    \"input_mapped\": %" PRIu64 "\n", run->input_mapped);
+    fprintf(stdout, "  },\n");
+
+    fprintf(stdout, "  \"time_ns\": {\n");
+    fprintf(stdout, "    \"load\": { \"wall\": %" PRIu64 ", \"cpu\": %" PRIu64 " },\n",
+        run->load_wall, run->load_cpu);
+    fprintf(stdout, "    \"tokenize\": { \"wall\": %" PRIu64 " },\n", stats->tokenize_ns);
+    fprintf(stdout, "    \"probe\": { \"wall\": %" PRIu64 " },\n", stats->probe_ns);
+    fprintf(stdout, "    \"filter\": { \"wall\": %" PRIu64 ", \"cpu\": %" PRIu64 " },\n",
+        run->filter_wall, run->filter_cpu);
+    fprintf(stdout, "    \"report\": { \"wall\": %" PRIu64 ", \"cpu\": %" PRIu64 " }\n", wall,
+        cpu);
+    fprintf(stdout, "  }\n");
+    fprintf(stdout, "}\n");
+}
+
+/* helper function that prints the statistics (formula credits: given in the lab doc) */
+static void print_stats(Dict *dict, Stats *stats, Run *run) {
+    if (run->json) {
+        print_json(dict, stats, run);
+        return;
+    }
+
+    HashTable *ht = dict_ht(dict); // NULL when filtering with a snapshot, baked tables or an automaton
+    BloomFilter *bf = dict_bf(dict); // NULL when baked or an automaton
+
+    fprintf(stdout, "Seeks: %" PRIu64 "\n", stats->seeks);
+    fprintf(stdout, "Average seek length: %0.6lf\n", ((double) stats->links) / stats->seeks);
+    if (ht) {
+        fprintf(stdout, "Hash table load: %0.6lf%%\n",
+            100 * (((double) ht_count(ht)) / ht_size(ht)));
+        fprintf(stdout, "Hash table arena: %zu bytes used (%zu reserved)\n",
+            arena_used(ht_arena(ht)), arena_reserved(ht_arena(ht)));
+    } else if (dict_dafsa(dict)) {
+        Dafsa *a = dict_dafsa(dict);
+        fprintf(stdout, "Automaton: %u words, %u states, %u edges, %zu bytes\n", dafsa_entries(a),
+            dafsa_states(a), dafsa_edges(a), dafsa_bytes(a));
+    } else if (dict_baked(dict)) {
+        fprintf(stdout, "Baked dictionary: %u words, %zu bytes\n", dict_baked(dict)->entries,
+            baked_bytes(dict_baked(dict)));
+    } else {
+        Snapshot *s = dict_snapshot(dict);
+        fprintf(stdout, "Snapshot index load: %0.6lf%%\n",
+            100 * (((double) snapshot_entries(s)) / snapshot_size(s)));
+    }
+    if (dict_phrases(dict)) {
+        Phrases *p = dict_phrases(dict);
+        fprintf(stdout, "Phrases: %u phrases of %u words, %u states, %zu bytes\n",
+            phrases_count(p), phrases_tokens(p), phrases_states(p), phrases_bytes(p));
+    }
+    if (dict_normalizer(dict)) {
+        Normalizer *z = dict_normalizer(dict);
+        fprintf(stdout, "Canonical forms: %u forms, %u substitutions, %zu bytes\n",
+            normalizer_count(z), normalizer_rules(z), normalizer_bytes(z));
+        fprintf(stdout, "Obfuscated words: %" PRIu64 "\n", stats->normalized);
+    }
+    if (bf)
+        fprintf(stdout, "Bloom filter load: %0.6lf%%\n",
+            100 * (((double) bf_count(bf)) / bf_size(bf)));
+    if (dict_dafsa(dict))
+        return; // nothing is probed before an automaton is walked
+
+    /* observed rate is over the words that were not in the ht (probes - true hits) */
+    uint64_t negatives = stats->probes - (stats->passes - stats->false_positives);
+    fprintf(stdout, "Bloom filter layout: %s\n", layout(dict));
+    fprintf(stdout, "Bloom filter false positives: %" PRIu64 "\n", stats->false_positives);
+    fprintf(stdout, "Bloom filter false positive rate: %0.6lf%% (expected %0.6lf%%)\n",
+        negatives ? 100 * ((double) stats->false_positives) / negatives : 0.0,
+        100 * expected_fp_rate(dict));
+}
+
+/* helper function that builds the dictionary from badspeak.txt and newspeak.txt */
+/* (counting makes a counting BF, so words can be removed from the dictionary) */
+/* (automaton builds the words into a Dafsa, so there is no BF and the HT is temporary) */
+/* (normalize indexes the words by their canonical forms, see normalize.c) */
+static Dict *build_dict(uint32_t ht_len, uint32_t bf_len, bool mtf, bool open, bool blocked,
+    bool counting, bool automaton, bool normalize, HashBackend backend) {
+
+    /* initaliazing ht and bf and handling err */
+    HashTable *ht = ht_create(ht_len, mtf, open);
+    if (!ht) {
+        fprintf(stderr, "Failed to create Hash Table.\n");
+        return NULL;
+    }
+
+    BloomFilter *bf = automaton ? NULL
+                      : counting ? bf_create_counting(bf_len, blocked)
+                                 : bf_create(bf_len, blocked);
+    if (!bf && !automaton) {
+        fprintf(stderr, "Failed to create Bloom Filter.\n");
+        main_err(NULL, ht, NULL, NULL, NULL);
+        return NULL;
+    }
+
+    /* salt for the digest shared by the bf and ht (the ht salt from the lab doc) */
+    uint64_t salt[2] = { 0x9846e4f157fe8840, 0xc5f318d7e055afb8 };
+
+    Hasher *hasher = hasher_create(backend, salt); // expands the salt once
+    if (!hasher) {
+        fprintf(stderr, "Failed to create hasher.\n");
+        main_err(NULL, ht, bf, NULL, NULL);
+        return NULL;
+    }
+
+    /* the quoted entries of both files */
+    Phrases *phrases = phrases_create();
+    if (!phrases) {
+        fprintf(stderr, "Failed to create phrases.\n");
+        main_err(NULL, ht, bf, hasher, NULL);
+        return NULL;
+    }
+
+    /* the substitutions the words are indexed with, before any word is */
+    Normalizer *normalizer = normalize ? normalizer_create() : NULL;
+    if (normalize && (!normalizer || !read_table(normalizer))) {
+        fprintf(stderr, normalizer ? "Invalid substitution in leetspeak.txt.\n"
+                                   : "Failed to create normalizer.\n");
+        normalizer_delete(&normalizer);
+        phrases_delete(&phrases);
+        main_err(NULL, ht, bf, hasher, NULL);
+        return NULL;
+    }
+
+    /* read in badspeak and update bloom filter and ht */
+    FILE *bad_file = fopen("badspeak.txt", "r");
+    if (!bad_file) {
+        fprintf(stderr, "Failed to open badspeak.txt file.\n");
+        normalizer_delete(&normalizer);
+        phrases_delete(&phrases);
+        main_err(NULL, ht, bf, hasher, NULL);
+        return NULL;
+    }
+    bool read = read_file(bad_file, ht, bf, hasher, phrases, normalizer, true); // call the helper function (true because reading badspeak)
+
+    /* read in newspeak file and update bf and ht */
+    FILE *new_file = fopen("newspeak.txt", "r");
+    if (!new_file) {
+        fprintf(stderr, "Failed to open newspeak.txt file.\n");
+        normalizer_delete(&normalizer);
+        phrases_delete(&phrases);
+        main_err(NULL, ht, bf, hasher, NULL);
+        return NULL;
+    }
+    read = read_file(new_file, ht, bf, hasher, phrases, normalizer, false) && read; // call the helper function (false because reading newspeak)
+
+    hasher_delete(&hasher); // the dict makes its own from the same salt
+
+    /* link the phrases' automaton once they are all in */
+    if (!read || !phrases_build(phrases)) {
+        fprintf(stderr, "Failed to allocate memory for the phrases or canonical forms.\n");
+        normalizer_delete(&normalizer);
+        phrases_delete(&phrases);
+        main_err(NULL, ht, bf, NULL, NULL);
+        return NULL;
+    }
+
+    Dict *dict = automaton ? dict_automaton(ht, backend, salt) // deletes the ht
+                           : dict_create(ht, bf, backend, salt); // owns the ht and bf now
+    if (!dict) {
+        fprintf(stderr, "Failed to create dictionary.\n");
+        normalizer_delete(&normalizer);
+        phrases_delete(&phrases);
+        main_err(NULL, ht, bf, NULL, NULL);
+        return NULL;
+    }
+
+    dict_set_phrases(dict, phrases); // owns them now (if there are any)
+    dict_set_normalizer(dict, normalizer); // and the index (if -n)
+    return dict;
+}
+
+/* build function of the live dictionary with -r (runs on its watcher thread) */
+static Dict *reload_dict(void *arg) {
+    Reload *r = (Reload *) arg;
+    if (r->snapshot_path)
+        return dict_open(r->snapshot_path);
+    return build_dict(r->ht_len, r->bf_len, r->mtf, r->open, r->blocked, r->counting, r->automaton,
+        r->normalize, r->backend);
+}
+
+/* streams stdin through a live dictionary that is reloaded as it changes (-r) and edited (-e) */
+static int stream_main(
+    Dict *dict, Reload *reload, const char *edits_path, bool stats_only, Run *run) {
+    static const char *word_files[] = { "badspeak.txt", "newspeak.txt", "leetspeak.txt" };
+    const char *snapshot_files[] = { reload->snapshot_path };
+
+    Live *live = live_create(dict, 1); // the only reader is this thread
+    if (!live) {
+        fprintf(stderr, "Failed to allocate memory for the live dictionary.\n");
+        dict_delete(&dict);
+        return -1;
+    }
+
+    bool watching = reload->snapshot_path ? live_watch(live, reload_dict, reload, snapshot_files, 1)
+                                          : live_watch(live, reload_dict, reload, word_files,
+                                              reload->normalize ? 3 : 2); // (leetspeak.txt may not be there yet)
+    Filter *f = filter_create(dict);
+    Input *in = input_open(STDIN_FILENO, true);
+
+    if (!watching || !f || !in) {
+        fprintf(stderr, "Failed to start filtering the stream.\n");
+        input_close(&in);
+        filter_delete(&f);
+        live_delete(&live);
+        return -1;
+    }
+
+    Stats stats = { 0 };
+    Edits edits = { edits_path, 0, 0, 0, 0 };
+    filter_time(f, stats_only);
+    uint64_t wall = stats_clock(CLOCK_MONOTONIC), cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+    bool filtered = filter_stream(f, live, in, edits_path ? &edits : NULL, stats_only, &stats);
+    run->filter_wall = stats_clock(CLOCK_MONOTONIC) - wall;
+    run->filter_cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    run->filter_bytes = filter_bytes(f);
+    run->input_bytes = input_bytes(in, &(run->input_mapped));
+    input_close(&in);
+    filter_delete(&f);
+
+    if (!filtered)
+        fprintf(stderr, "Failed to allocate memory to filter the input.\n");
+    else if (stats_only) {
+        print_stats(live_enter(live, 0), &stats, run); // of the latest version
+        live_exit(live, 0);
+    }
+
+    live_delete(&live); // stops the watcher and deletes the dict
+    return filtered ? 0 : -1;
+}
+
 int main(int argc, char **argv) {
 
     /* default values */
     uint32_t ht_len = 10000;
     uint32_t bf_len = 1048576; // 2^20
+    HashBackend backend = SPECK;
+    char *compile_path = NULL; // -c: snapshot to write
+    char *bake_path = NULL; // -B: C source to write
+    char *snapshot_path = NULL; // -d: snapshot to filter with
+    uint32_t jobs = 1; // -j: filtering threads
+    char *socket_path = NULL; // -u: socket to serve on
+    char *edits_path = NULL; // -e: edit log applied while streaming
+    char *records = NULL; // -R: record format of stdin
+    RecordFormat format = RECORD_LINE;
+    Run run; // timing and memory for -s
+    memset(&run, 0, sizeof(Run));
 
     /* flag parsing */
-    enum flags { Stat = 0, Mtf };
-    BitVector *args = bv_create(2); // using already made bv instead of set. only 2 args added
+    enum flags { Stat = 0, Mtf, Blocked, Open, Stream, Automaton, Normalize, Build, NUM_FLAGS }; // Build: -t, -f, -H
+    BitVector *args = bv_create(NUM_FLAGS); // using already made bv instead of set
 
     /* for getopt/arg parsing */
     int c;
-    char *optlist = "hsmt:f:";
+    char *optlist = "hsJmboanrt:f:H:c:d:j:u:e:R:B:";
 
     /* parsing arguments and adding flags */
     while ((c = getopt(argc, argv, optlist)) != -1) {
         switch (c) {
         case 'h':
             usage(argv[0]);
-            main_err(args, NULL, NULL);
+            main_err(args, NULL, NULL, NULL, NULL);
             return 0;
         case 's': bv_set_bit(args, Stat); break;
+        case 'J':
+            bv_set_bit(args, Stat);
+            run.json = true;
+            break;
         case 'm': bv_set_bit(args, Mtf); break;
-        case 't': ht_len = (uint32_t) atoi(optarg); break;
-        case 'f': bf_len = (uint32_t) atoi(optarg); break;
+        case 'b': bv_set_bit(args, Blocked); break;
+        case 'o': bv_set_bit(args, Open); break;
+        case 'a': bv_set_bit(args, Automaton); break;
+        case 'n': bv_set_bit(args, Normalize); break;
+        case 'r': bv_set_bit(args, Stream); break;
+        case 't':
+            ht_len = (uint32_t) atoi(optarg);
+            bv_set_bit(args, Build);
+            break;
+        case 'f':
+            bf_len = (uint32_t) atoi(optarg);
+            bv_set_bit(args, Build);
+            break;
+        case 'H':
+            bv_set_bit(args, Build);
+            if (!backend_parse(optarg, &backend)) {
+                fprintf(stderr, "Invalid hash backend.\n");
+                main_err(args, NULL, NULL, NULL, NULL);
+                return -1;
+            }
+            break;
+        case 'c': compile_path = optarg; break;
+        case 'B': bake_path = optarg; break;
+        case 'd': snapshot_path = optarg; break;
+        case 'j': jobs = (uint32_t) atoi(optarg); break;
+        case 'u': socket_path = optarg; break;
+        case 'e': edits_path = optarg; break;
+        case 'R':
+            records = optarg;
+            if (!record_format(optarg, &format)) {
+                fprintf(stderr, "Invalid record format.\n");
+                main_err(args, NULL, NULL, NULL, NULL);
+                return -1;
+            }
+            break;
         default:
             usage(argv[0]);
-            main_err(args, NULL, NULL);
+            main_err(args, NULL, NULL, NULL, NULL);
             return -1;
         }
     }
 
-    /* invalid BF or HT sizes */
-    if (!bf_len) {
+    /* invalid BF or HT sizes (a blocked BF's bits, rounded up to whole blocks, must fit 32 bits) */
+    if (!bf_len || bf_rounded(bf_len, bv_get_bit(args, Blocked)) > UINT32_MAX) {
         fprintf(stderr, "Invalid bloom filter size.\n");
-        main_err(args, NULL, NULL);
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
     if (!ht_len) {
         fprintf(stderr, "Invalid hash table size.\n");
-        main_err(args, NULL, NULL);
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
-    /* initaliazing ht and bf and handling err */
-    HashTable *ht = ht_create(ht_len, bv_get_bit(args, Mtf)); // mtf true if arg bit set
-    if (!ht) {
-        fprintf(stderr, "Failed to create Hash Table.\n");
-        main_err(args, NULL, NULL);
+    if (!jobs) {
+        fprintf(stderr, "Invalid number of threads.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
-    BloomFilter *bf = bf_create(bf_len);
-    if (!bf) {
-        fprintf(stderr, "Failed to create Bloom Filter.\n");
-        main_err(args, ht, NULL);
+#ifdef BANHAMMER_STATIC
+    if (compile_path || bake_path || snapshot_path || edits_path || bv_get_bit(args, Stream)) {
+        fprintf(stderr, "Cannot compile, load or reload a dictionary: it is baked in.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
-    /* read in badspeak and update bloom filter and ht */
-    FILE *bad_file = fopen("badspeak.txt", "r");
-    if (!bad_file) {
-        fprintf(stderr, "Failed to open badspeak.txt file.\n");
-        main_err(args, ht, bf);
+    if (bv_get_bit(args, Normalize)) {
+        fprintf(stderr, "Cannot index the baked dictionary by canonical forms.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
-    read_file(bad_file, ht, bf, true); // call the helper function (true because reading badspeak)
 
-    /* read in newspeak file and update bf and ht */
-    FILE *new_file = fopen("newspeak.txt", "r");
-    if (!new_file) {
-        fprintf(stderr, "Failed to open newspeak.txt file.\n");
-        main_err(args, ht, bf);
+    /* its layout and hash were chosen when it was baked */
+    if (bv_get_bit(args, Automaton) || bv_get_bit(args, Open) || bv_get_bit(args, Blocked)
+        || bv_get_bit(args, Build)) {
+        fprintf(stderr, "Cannot rebuild the baked dictionary with -a, -t, -f, -o, -b or -H.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
-    read_file(new_file, ht, bf, false); // call the helper function (false because reading newspeak)
+#endif
 
-    /* read in from stdin and filter the words */
+    if (bake_path && (compile_path || snapshot_path || socket_path || bv_get_bit(args, Stream))) {
+        fprintf(stderr, "Cannot compile C source with -c, -d, -u or -r.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
 
-    bool thoughtcrime = false, rightcrime = false; // to track which crime did the citizen commit
-    Node *temp = NULL; // to store the hash table entry
+    if (compile_path && socket_path) {
+        fprintf(stderr, "Cannot both compile a snapshot and serve.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
 
-    bool print_stats = bv_get_bit(args, Stat); // only do some things below if not printing stats
+    if (bv_get_bit(args, Stream) && (compile_path || socket_path || jobs > 1)) {
+        fprintf(stderr, "Cannot stream with -c, -u or more than one thread.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
 
-    /* buffer to store transgressions */
-    LinkedList *bad_buf = NULL, *right_buf = NULL;
+    if (records && (bv_get_bit(args, Stream) || compile_path || socket_path || jobs > 1)) {
+        fprintf(stderr, "Cannot filter records with -r, -c, -u or more than one thread.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
 
-    // no need for buffer if only printing stats
-    bad_buf = ll_create(bv_get_bit(args, Mtf)); // true to make checking for repeated words faster
-    right_buf = ll_create(bv_get_bit(args, Mtf));
+    if (edits_path && (!bv_get_bit(args, Stream) || snapshot_path)) {
+        fprintf(stderr, "Can only apply edits while streaming the word files (-r without -d).\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
 
-    /* cannot allocate mem (and not printing stats) */
-    if (!bad_buf || !right_buf) {
-        fprintf(stderr, "Failed to allocate memory for buffers to store the transgressions.\n");
-        ll_delete(&bad_buf);
-        ll_delete(&right_buf);
-        main_err(args, ht, bf);
+    if (bv_get_bit(args, Automaton) && (compile_path || bake_path || snapshot_path || edits_path)) {
+        fprintf(stderr, "Cannot use an automaton with -c, -B, -d or -e.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
+
+    if (bv_get_bit(args, Normalize) && (compile_path || bake_path || snapshot_path)) {
+        fprintf(stderr, "Cannot match obfuscated words with -c, -B or -d.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
+
+    /* threads share the ht, so its lists cannot move words to the front under -j */
+    if (bv_get_bit(args, Mtf) && jobs > 1) {
+        fprintf(stderr, "Cannot move words to the front with more than one thread.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
+        return -1;
+    }
+
+    if (compile_path && snapshot_path) {
+        fprintf(stderr, "Cannot both compile and load a snapshot.\n");
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
-    /* compile regex (credits: based on the sample code provided in the lab doc) */
-    regex_t re;
+    Dict *dict = NULL;
+    uint64_t wall = stats_clock(CLOCK_MONOTONIC), cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
 
-    if (regcomp(&re, PATTERN, REG_EXTENDED)) {
-        fprintf(stderr, "Failed to compile regex.\n");
-        ll_delete(&bad_buf);
-        ll_delete(&right_buf);
-        main_err(args, ht, bf); // add to main err later
+#ifdef BANHAMMER_STATIC
+    /* filter with the tables compiled into the binary (nothing to read at all) */
+    dict = dict_static(&baked_dictionary);
+    if (!dict)
+        fprintf(stderr, "Failed to create dictionary.\n");
+#else
+    /* map the compiled snapshot (nothing to parse or insert) */
+    if (snapshot_path) {
+        dict = dict_open(snapshot_path);
+        if (!dict)
+            fprintf(stderr, "Failed to load snapshot %s.\n", snapshot_path);
+    }
+
+    /* or build the dictionary from the word files */
+    else
+        dict = build_dict(ht_len, bf_len, bv_get_bit(args, Mtf),
+            bv_get_bit(args, Open), bv_get_bit(args, Blocked), edits_path != NULL,
+            bv_get_bit(args, Automaton), bv_get_bit(args, Normalize), backend);
+#endif
+
+    if (!dict) {
+        main_err(args, NULL, NULL, NULL, NULL);
         return -1;
     }
 
-    char *word = NULL; // returned by next_word
+    run.load_wall = stats_clock(CLOCK_MONOTONIC) - wall;
+    run.load_cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
 
-    /* start scanning */
-    while ((word = next_word(stdin, &re)) != NULL) {
+    /* snapshots and baked tables only hold words */
+    if ((compile_path || bake_path) && dict_phrases(dict)) {
+        fprintf(stderr, "Cannot compile phrases into a snapshot or C source.\n");
+        main_err(args, NULL, NULL, NULL, dict);
+        return -1;
+    }
 
-        lower_str(word);
+    /* only compiling: save the snapshot and exit */
+    if (compile_path) {
+        bool saved = dict_save(dict, compile_path);
+        if (!saved)
+            fprintf(stderr, "Failed to write snapshot %s.\n", compile_path);
+        main_err(args, NULL, NULL, NULL, dict);
+        return saved ? 0 : -1;
+    }
 
-        /* if word is in the bf and in the ht (no false positive) */
-        if (bf_probe(bf, word) && (temp = ht_lookup(ht, word))) {
+    /* or bake it into C source and exit */
+    if (bake_path) {
+        bool baked = dict_bake(dict, bake_path);
+        if (!baked)
+            fprintf(stderr, "Failed to write C source %s.\n", bake_path);
+        main_err(args, NULL, NULL, NULL, dict);
+        return baked ? 0 : -1;
+    }
 
-            /* no newspeak translation. citizen committed thoughtcrime */
-            if (!(temp->newspeak)) {
-                thoughtcrime = true;
-                ll_insert(bad_buf, word, NULL);
-            }
+    /* or serve requests until interrupted (see server.h) */
+    if (socket_path) {
+        Stats stats = { 0 };
+        wall = stats_clock(CLOCK_MONOTONIC);
+        cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+        bool served = server_run(dict, socket_path, jobs, &stats);
+        run.filter_wall = stats_clock(CLOCK_MONOTONIC) - wall; // the time served
+        run.filter_cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+        if (!served)
+            fprintf(stderr, "Failed to serve on %s.\n", socket_path);
+        else if (bv_get_bit(args, Stat))
+            print_stats(dict, &stats, &run);
+        main_err(args, NULL, NULL, NULL, dict);
+        return served ? 0 : -1;
+    }
 
-            /* there is a newspeak entry. counsel on rightcrime */
-            else {
-                rightcrime = true;
-                ll_insert(right_buf, word, temp->newspeak);
-            }
-        }
+    /* or filter stdin as a stream, reloading the dictionary as it changes */
+    if (bv_get_bit(args, Stream)) {
+        Reload reload = { ht_len, bf_len, bv_get_bit(args, Mtf), bv_get_bit(args, Open),
+            bv_get_bit(args, Blocked), backend, snapshot_path, edits_path != NULL,
+            bv_get_bit(args, Automaton), bv_get_bit(args, Normalize) };
+        int status = stream_main(dict, &reload, edits_path, bv_get_bit(args, Stat), &run);
+        main_err(args, NULL, NULL, NULL, NULL);
+        return status;
     }
 
+    /* read in from stdin and filter the words */
+
+    bool stats_only = bv_get_bit(args, Stat); // only do some things below if not printing stats
+
+    /* the transgressions and counters (see filter.h) */
+    Filter *f = filter_create(dict);
+
+    /* stdin is mapped if it is a file, read in large chunks otherwise */
+    Input *in = input_open(STDIN_FILENO, false);
+
+    /* cannot allocate mem */
+    if (!f || !in) {
+        fprintf(stderr, "Failed to allocate memory for buffers to store the transgressions.\n");
+        input_close(&in);
+        filter_delete(&f);
+        main_err(args, NULL, NULL, NULL, dict);
+        return -1;
+    }
+
+    /* with -n no chunk ends inside an obfuscated word (b.a.d) */
+    input_join(in, normalizer_joiners(dict_normalizer(dict)));
+
+    /* filter it record by record, split it between threads, or scan it here word by word */
+    Stats record_stats = { 0 }; // summed over the records (-R)
+    filter_time(f, stats_only);
+    wall = stats_clock(CLOCK_MONOTONIC);
+    cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+    bool filtered = records   ? filter_records(f, in, format, stats_only, &record_stats)
+                    : jobs > 1 ? filter_parallel(f, dict, in, jobs, stats_only ? &run : NULL)
+                               : filter_serial(f, in);
+    run.filter_wall = stats_clock(CLOCK_MONOTONIC) - wall;
+    run.filter_cpu = stats_clock(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    run.filter_bytes += filter_bytes(f);
+    run.input_bytes = input_bytes(in, &(run.input_mapped));
+    input_close(&in);
+
+    if (!filtered) {
+        fprintf(stderr, "Failed to allocate memory to filter the input.\n");
+        filter_delete(&f);
+        main_err(args, NULL, NULL, NULL, dict);
+        return -1;
+    }
+
+    /* (the records were reported as they were filtered, so no letter follows them) */
+    Stats *stats = records ? &record_stats : filter_stats(f);
+    bool thoughtcrime = collector_count(filter_badspeak(f)) > 0; // which crime did the citizen commit
+    bool rightcrime = collector_count(filter_rightspeak(f)) > 0;
+
     /* if else to avoid repeating free mem code */
-    /* print stats (formula credits: given in the lab doc) */
-    if (print_stats) {
-        fprintf(stdout, "Seeks: %" PRIu64 "\n", seeks);
-        fprintf(stdout, "Average seek length: %0.6lf\n", ((double) links) / seeks);
-        fprintf(
-            stdout, "Hash table load: %0.6lf%%\n", 100 * (((double) ht_count(ht)) / ht_size(ht)));
-        fprintf(
-            stdout, "Bloom filter load: %0.6lf%%\n", 100 * (((double) bf_count(bf)) / bf_size(bf)));
+    if (stats_only) {
+        print_stats(dict, stats, &run);
     }
 
     /* notify the citizens of their errors */
@@ -247,28 +1206,26 @@ int main(int argc, char **argv) {
         /* mixspeak message if both thoughtcrime and rightcrime */
         if (thoughtcrime && rightcrime) {
             fprintf(stdout, "%s", mixspeak_message);
-            ll_print(bad_buf);
-            ll_print(right_buf);
+            collector_print(filter_badspeak(f));
+            collector_print(filter_rightspeak(f));
         }
 
         /* only committed thoughtcrime. give badspeak message */
         else if (thoughtcrime && !rightcrime) {
             fprintf(stdout, "%s", badspeak_message);
-            ll_print(bad_buf);
+            collector_print(filter_badspeak(f));
         }
 
         /* only accused of wrongthing. requires counseling. goodspeak message */
         else if (!thoughtcrime && rightcrime) {
             fprintf(stdout, "%s", goodspeak_message);
-            ll_print(right_buf);
+            collector_print(filter_rightspeak(f));
         }
     }
 
     /* freeing mem */
-    regfree(&re);
-    ll_delete(&bad_buf);
-    ll_delete(&right_buf);
-    main_err(args, ht, bf);
+    filter_delete(&f);
+    main_err(args, NULL, NULL, NULL, dict);
 
     return 0;
 }
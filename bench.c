@@ -0,0 +1,688 @@
+#include "arena.h"
+#include "bf.h"
+#include "dafsa.h"
+#include "dict.h"
+#include "filter.h"
+#include "hash.h"
+#include "ht.h"
+#include "ll.h"
+#include "parser.h"
+
+#include <inttypes.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WORD_LEN 16 // stride of a word in the word pool (max 15 chars + NUL)
+#define BATCH    32 // words per bf_probe_batch call (like banhammer's filter)
+#define LL_WORDS 32 // dictionary words in the list ll_lookup is timed on
+
+static volatile uint64_t sink = 0; // keeps timed loops from being optimized away
+
+/* the parameters of a run (see usage) */
+typedef struct Config {
+    uint32_t bf_len;
+    uint32_t ht_len;
+    uint32_t keys; // dictionary words
+    uint32_t tokens; // words in the corpus
+    uint32_t vocab; // distinct words that are not in the dictionary
+    double skew; // Zipf exponent of word frequencies
+    double hit_rate; // fraction of the corpus that are dictionary words
+    uint64_t seed;
+    uint32_t reps; // runs of every stage (the fastest is reported)
+    bool json;
+} Config;
+
+/* the generated input and everything the stages share */
+typedef struct Corpus {
+    char *pool; // the vocabulary, then the dictionary words (WORD_LEN apart)
+    char *text; // the corpus (WORDS_PADDING zero bytes past its end)
+    uint64_t size;
+    uint32_t count; // words found in it by the scanner
+    const char **views; // the words as found in the text
+    uint32_t *lengths;
+    char **words; // their lowercased copies (NUL terminated)
+    char *lowered;
+    bool *in_dict; // the word is a dictionary word
+    uint32_t misses; // words that are not
+    Digest *digests;
+    bool *hits;
+} Corpus;
+
+/* one measurement */
+typedef struct Result {
+    const char *stage;
+    const char *variant;
+    uint64_t ops; // words processed per run
+    uint64_t ns; // fastest run
+    int64_t bytes; // heap allocated by the stage (its structures included)
+    double fp_rate; // observed Bloom filter false positive rate (< 0 if none)
+    double expected; // and the theoretical one
+} Result;
+
+/* helper function to print usage */
+static void usage(char *argv) {
+    fprintf(stdout,
+        "SYNOPSIS\n"
+        "  Benchmarks each stage of banhammer on a generated corpus: the word\n"
+        "  scanner, lowercasing, the hash backends, the Bloom filter layouts (one\n"
+        "  word at a time and in batches), the hash table engines, the linked list\n"
+        "  with and without move-to-front, the word automaton, and the whole filter. Reports words/s,\n"
+        "  ns/op and the bytes allocated by every stage. The corpus only depends on\n"
+        "  the options, so runs with the same options can be compared.\n"
+        "\n"
+        "USAGE\n"
+        "  %s [-hJ] [-f size] [-t size] [-n keys] [-p words] [-v vocab] [-z skew]\n"
+        "     [-r rate] [-S seed] [-R reps]\n"
+        "\n"
+        "OPTIONS\n"
+        "  -h           Program usage and help.\n"
+        "  -J           Print one JSON object per line instead of a table.\n"
+        "  -f size      Bloom filter size (default: 2^20).\n"
+        "  -t size      Initial hash table size (default: 10000).\n"
+        "  -n keys      Dictionary words, half of them with a newspeak (default: 50000).\n"
+        "  -p words     Words in the corpus (default: 1000000).\n"
+        "  -v vocab     Distinct corpus words not in the dictionary (default: 100000).\n"
+        "  -z skew      Zipf exponent of word frequencies, 0 is uniform (default: 1.0).\n"
+        "  -r rate      Fraction of corpus words that are in the dictionary (default: 0.05).\n"
+        "  -S seed      Seed of the corpus generator (default: 1).\n"
+        "  -R reps      Runs of every stage, the fastest is reported (default: 3).\n",
+        argv);
+}
+
+/* helper function for a monotonic time stamp in ns */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/* helper function for the bytes the heap has handed out (0 where it cannot be asked) */
+static int64_t heap_bytes(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    return (int64_t) (mi.uordblks + mi.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+/* helper function for the next number of the generator (splitmix64) */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+/* helper function for a uniform double in [0, 1) */
+static double next_unit(uint64_t *state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * helper function that writes the i-th word of the pool. distinct i (below
+ * 2^44) give distinct words: i is scrambled by an odd multiplier modulo 2^44,
+ * which is a bijection, then written in base 26 (at most 10 letters)
+ */
+static uint32_t make_word(char *out, uint64_t i) {
+    uint64_t x = (i * 0x9e3779b97f4a7c15) & ((1ull << 44) - 1); // scramble, keep the low 44 bits
+    uint32_t len = 0;
+    do {
+        out[len++] = (char) ('a' + x % 26);
+        x /= 26;
+    } while (x && len < WORD_LEN - 1);
+    out[len] = '\0';
+    return len;
+}
+
+/* helper function that makes the cumulative Zipf distribution of ranks 0 .. n-1 */
+static double *zipf_create(uint32_t n, double skew) {
+    double *cdf = (double *) malloc((size_t) n * sizeof(double));
+    if (!cdf)
+        return NULL;
+
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++)
+        cdf[i] = (sum += 1.0 / pow(i + 1.0, skew));
+    for (uint32_t i = 0; i < n; i++)
+        cdf[i] /= sum;
+
+    return cdf;
+}
+
+/* helper function that draws a rank from a cumulative distribution of n ranks */
+static uint32_t zipf_draw(const double *cdf, uint32_t n, uint64_t *state) {
+    double u = next_unit(state);
+    uint32_t lo = 0, hi = n - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* helper function that frees a corpus */
+static void corpus_delete(Corpus *c) {
+    free(c->pool);
+    free(c->text);
+    free(c->views);
+    free(c->lengths);
+    free(c->words);
+    free(c->lowered);
+    free(c->in_dict);
+    free(c->digests);
+    free(c->hits);
+    return;
+}
+
+/*
+ * generates the corpus: cfg->tokens words, each a dictionary word with
+ * probability hit_rate, and both kinds drawn with Zipf frequencies (rank 0
+ * is the most frequent). some words are capitalized and the separators vary,
+ * so the scanner and lowercasing have real work. returns false if out of memory.
+ */
+static bool corpus_create(Corpus *c, Config *cfg) {
+    memset(c, 0, sizeof(Corpus));
+    uint64_t state = cfg->seed;
+    static const char *separators[] = { " ", " ", " ", " ", ", ", ". ", "\n", " - ", "; " };
+    uint32_t kinds = sizeof(separators) / sizeof(separators[0]);
+
+    uint32_t words = cfg->vocab + cfg->keys;
+    c->pool = (char *) malloc((size_t) words * WORD_LEN);
+    c->text = (char *) malloc((size_t) cfg->tokens * (WORD_LEN + 3) + WORDS_PADDING);
+    c->views = (const char **) malloc((size_t) cfg->tokens * sizeof(char *));
+    c->lengths = (uint32_t *) malloc((size_t) cfg->tokens * sizeof(uint32_t));
+    c->words = (char **) malloc((size_t) cfg->tokens * sizeof(char *));
+    c->lowered = (char *) malloc((size_t) cfg->tokens * WORD_LEN);
+    c->in_dict = (bool *) malloc((size_t) cfg->tokens * sizeof(bool));
+    c->digests = (Digest *) malloc((size_t) cfg->tokens * sizeof(Digest));
+    c->hits = (bool *) malloc((size_t) cfg->tokens * sizeof(bool));
+    double *vocab_cdf = zipf_create(cfg->vocab, cfg->skew);
+    double *dict_cdf = zipf_create(cfg->keys, cfg->skew);
+
+    if (!c->pool || !c->text || !c->views || !c->lengths || !c->words || !c->lowered
+        || !c->in_dict || !c->digests || !c->hits || !vocab_cdf || !dict_cdf) {
+        free(vocab_cdf);
+        free(dict_cdf);
+        corpus_delete(c);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < words; i++)
+        make_word(c->pool + (size_t) i * WORD_LEN, i);
+
+    /* write the words and what separates them */
+    for (uint32_t i = 0; i < cfg->tokens; i++) {
+        bool hit = next_unit(&state) < cfg->hit_rate;
+        uint32_t w = hit ? cfg->vocab + zipf_draw(dict_cdf, cfg->keys, &state)
+                         : zipf_draw(vocab_cdf, cfg->vocab, &state);
+        const char *word = c->pool + (size_t) w * WORD_LEN;
+        uint32_t length = (uint32_t) strlen(word);
+
+        char *at = c->text + c->size;
+        memcpy(at, word, length);
+        if (next_random(&state) % 8 == 0)
+            at[0] = (char) (at[0] - 'a' + 'A');
+        c->size += length;
+
+        const char *sep = separators[next_random(&state) % kinds];
+        memcpy(c->text + c->size, sep, strlen(sep));
+        c->size += strlen(sep);
+        c->in_dict[i] = hit;
+    }
+    memset(c->text + c->size, 0, WORDS_PADDING);
+
+    free(vocab_cdf);
+    free(dict_cdf);
+
+    /* the scanner finds exactly the words written (the separators never join them) */
+    Words scan;
+    const char *view;
+    uint32_t length;
+    words_init(&scan, c->text, c->size);
+    while (c->count < cfg->tokens && (view = words_next(&scan, &length)) != NULL) {
+        c->views[c->count] = view;
+        c->lengths[c->count] = length;
+        c->words[c->count] = c->lowered + (size_t) c->count * WORD_LEN;
+        c->count++;
+    }
+
+    for (uint32_t i = 0; i < c->count; i++)
+        c->misses += !c->in_dict[i];
+
+    return c->count == cfg->tokens;
+}
+
+/* helper function that prints a measurement as a table row or a JSON object */
+static void report(Config *cfg, Result *r) {
+    double ns_op = r->ops ? (double) r->ns / r->ops : 0;
+    double words_s = r->ns ? r->ops * 1e9 / r->ns : 0;
+
+    if (cfg->json) {
+        fprintf(stdout,
+            "{\"stage\":\"%s\",\"variant\":\"%s\",\"ops\":%" PRIu64 ",\"ns\":%" PRIu64
+            ",\"ns_per_op\":%.3lf,\"words_per_s\":%.0lf,\"bytes\":%" PRId64,
+            r->stage, r->variant, r->ops, r->ns, ns_op, words_s, r->bytes);
+        if (r->fp_rate >= 0)
+            fprintf(stdout, ",\"fp_rate\":%.8lf,\"expected_fp_rate\":%.8lf", r->fp_rate,
+                r->expected);
+        fprintf(stdout, "}\n");
+        return;
+    }
+
+    fprintf(stdout, "%-15s %-26s %10.2lf %14.0lf %12" PRId64, r->stage, r->variant, ns_op, words_s,
+        r->bytes);
+    if (r->fp_rate >= 0)
+        fprintf(stdout, " %11.6lf%% %11.6lf%%", 100 * r->fp_rate, 100 * r->expected);
+    fprintf(stdout, "\n");
+    return;
+}
+
+/* helper function that reports a stage with no Bloom filter rates */
+static void report_stage(
+    Config *cfg, const char *stage, const char *variant, uint64_t ops, uint64_t ns, int64_t bytes) {
+    Result r = { stage, variant, ops, ns, bytes, -1, -1 };
+    report(cfg, &r);
+    return;
+}
+
+/* times the word scanner over the corpus */
+static void bench_scan(Config *cfg, Corpus *c) {
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        Words w;
+        uint32_t length;
+        uint64_t n = 0;
+
+        uint64_t start = now_ns();
+        words_init(&w, c->text, c->size);
+        while (words_next(&w, &length) != NULL)
+            n += length;
+        uint64_t elapsed = now_ns() - start;
+
+        sink ^= n;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "words_next", "-", c->count, best, 0);
+}
+
+/* times lowercasing the words into the pool of copies */
+static void bench_lower(Config *cfg, Corpus *c) {
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++) {
+            words_lower(c->words[i], c->views[i], c->lengths[i]);
+            c->words[i][c->lengths[i]] = '\0';
+        }
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "words_lower", "-", c->count, best, 0);
+}
+
+/* times case folding the words (the corpus is ASCII, so they fold into copies of the same length) */
+static void bench_fold(Config *cfg, Corpus *c) {
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++) {
+            uint32_t length = words_fold(c->words[i], c->views[i], c->lengths[i]);
+            c->words[i][length] = '\0';
+        }
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "words_fold", "-", c->count, best, 0);
+}
+
+/* times a hash backend over the lowercased words (leaving their digests in c) */
+static void bench_hash(Config *cfg, Corpus *c, Hasher *hasher) {
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++)
+            c->digests[i] = hasher_digest(hasher, c->words[i], c->lengths[i]);
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "hash", backend_name(hasher_backend(hasher)), c->count, best, 0);
+}
+
+/* times probing a Bloom filter layout with the digests in c, one at a time and batched */
+static bool bench_bf(Config *cfg, Corpus *c, Hasher *hasher, bool blocked) {
+    char variant[32];
+    snprintf(variant, sizeof(variant), "%s/%s", backend_name(hasher_backend(hasher)),
+        blocked ? "blocked" : "standard");
+
+    int64_t heap = heap_bytes();
+    BloomFilter *bf = bf_create(cfg->bf_len, blocked);
+    if (!bf)
+        return false;
+
+    for (uint32_t i = 0; i < cfg->keys; i++) {
+        char *word = c->pool + (size_t) (cfg->vocab + i) * WORD_LEN;
+        Digest d = hasher_digest(hasher, word, (uint32_t) strlen(word));
+        bf_insert(bf, &d);
+    }
+    int64_t bytes = heap_bytes() - heap;
+
+    /* one word at a time, counting the false positives (probes of words not inserted) */
+    uint64_t best = UINT64_MAX, positives = 0;
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        positives = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++)
+            c->hits[i] = bf_probe(bf, &(c->digests[i]));
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+
+        for (uint32_t i = 0; i < c->count; i++)
+            positives += c->hits[i] && !c->in_dict[i];
+    }
+
+    Result r = { "bf_probe", variant, c->count, best, bytes,
+        c->misses ? (double) positives / c->misses : 0, bf_fp_rate(bf) };
+    report(cfg, &r);
+
+    /* and in batches */
+    best = UINT64_MAX;
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i += BATCH) {
+            uint32_t n = c->count - i < BATCH ? c->count - i : BATCH;
+            bf_probe_batch(bf, c->digests + i, n, c->hits + i);
+        }
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    r.stage = "bf_probe_batch";
+    r.ns = best;
+    report(cfg, &r);
+
+    bf_delete(&bf);
+    return true;
+}
+
+/* times looking every word up in a hash table engine (with the digests in c) */
+static bool bench_ht(Config *cfg, Corpus *c, Hasher *hasher, bool open, bool mtf) {
+    int64_t heap = heap_bytes();
+    HashTable *ht = ht_create(cfg->ht_len, mtf, open);
+    if (!ht)
+        return false;
+
+    char newspeak[] = "doubleplusgood";
+    for (uint32_t i = 0; i < cfg->keys; i++) {
+        char *word = c->pool + (size_t) (cfg->vocab + i) * WORD_LEN;
+        Digest d = hasher_digest(hasher, word, (uint32_t) strlen(word));
+        ht_insert(ht, &d, word, i % 2 ? newspeak : NULL);
+    }
+    int64_t bytes = heap_bytes() - heap;
+
+    uint64_t best = UINT64_MAX;
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t found = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++)
+            found += ht_lookup(ht, &(c->digests[i]), c->words[i], c->lengths[i], NULL) != NULL;
+        uint64_t elapsed = now_ns() - start;
+        sink ^= found;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "ht_lookup", open ? "open" : mtf ? "chained/mtf" : "chained", c->count, best,
+        bytes);
+
+    ht_delete(&ht);
+    return true;
+}
+
+/*
+ * times looking every word up in one list of LL_WORDS dictionary words. the
+ * most frequent ones are inserted first, so they end up last in the list
+ * (where move-to-front helps most).
+ */
+static bool bench_ll(Config *cfg, Corpus *c, bool mtf) {
+    int64_t heap = heap_bytes();
+    Arena *arena = arena_create(4096);
+    LinkedList *ll = arena ? ll_create(mtf, arena) : NULL;
+    if (!ll) {
+        arena_delete(&arena);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < LL_WORDS && i < cfg->keys; i++)
+        ll_insert(ll, c->pool + (size_t) (cfg->vocab + i) * WORD_LEN, NULL);
+    int64_t bytes = heap_bytes() - heap;
+
+    uint64_t best = UINT64_MAX;
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t found = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++)
+            found += ll_lookup(ll, c->words[i], c->lengths[i], NULL) != NULL;
+        uint64_t elapsed = now_ns() - start;
+        sink ^= found;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "ll_lookup", mtf ? "mtf" : "-", c->count, best, bytes);
+
+    ll_delete(&ll);
+    arena_delete(&arena);
+    return true;
+}
+
+/* times walking every word (as found in the text, the walk lowercases it) through a Dafsa */
+static bool bench_dafsa(Config *cfg, Corpus *c) {
+    HashTable *ht = ht_create(cfg->ht_len, false, true);
+    if (!ht)
+        return false;
+
+    char newspeak[] = "doubleplusgood";
+    for (uint32_t i = 0; i < cfg->keys; i++) {
+        char *word = c->pool + (size_t) (cfg->vocab + i) * WORD_LEN;
+        Digest d = { i, i }; // only sorted out by the HT, the Dafsa does not hash
+        ht_insert(ht, &d, word, i % 2 ? newspeak : NULL);
+    }
+
+    int64_t heap = heap_bytes();
+    Dafsa *a = dafsa_create(ht);
+    int64_t bytes = heap_bytes() - heap;
+    ht_delete(&ht);
+    if (!a)
+        return false;
+
+    uint64_t best = UINT64_MAX;
+    for (uint32_t rep = 0; rep < cfg->reps; rep++) {
+        uint64_t found = 0;
+        Match m;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < c->count; i++)
+            found += dafsa_lookup(a, c->views[i], c->lengths[i], &(m.oldspeak), &(m.newspeak), NULL);
+        uint64_t elapsed = now_ns() - start;
+        sink ^= found;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    report_stage(cfg, "dafsa_lookup", "-", c->count, best, bytes);
+
+    dafsa_delete(&a);
+    return true;
+}
+
+/*
+ * times the whole filter (scan, lowercase, hash, probe, look up, collect)
+ * over the corpus. with automaton the dictionary is a Dafsa instead, so
+ * there is no hashing or probing (and no BF layout or HT engine).
+ */
+static bool bench_filter(Config *cfg, Corpus *c, HashBackend backend, bool blocked, bool open,
+    bool mtf, bool automaton) {
+    char variant[48];
+    snprintf(variant, sizeof(variant), "%s/%s/%s%s", backend_name(backend),
+        blocked ? "blocked" : "standard", open ? "open" : "chained", mtf ? "/mtf" : "");
+    if (automaton)
+        snprintf(variant, sizeof(variant), "dafsa");
+
+    uint64_t salt[2] = { 0x9846e4f157fe8840, 0xc5f318d7e055afb8 };
+    int64_t heap = heap_bytes();
+
+    /* the dictionary like banhammer builds it */
+    HashTable *ht = ht_create(cfg->ht_len, mtf, open);
+    BloomFilter *bf = automaton ? NULL : bf_create(cfg->bf_len, blocked);
+    Hasher *hasher = hasher_create(backend, salt);
+    if (!ht || (!bf && !automaton) || !hasher) {
+        ht_delete(&ht);
+        bf_delete(&bf);
+        hasher_delete(&hasher);
+        return false;
+    }
+
+    char newspeak[] = "doubleplusgood";
+    for (uint32_t i = 0; i < cfg->keys; i++) {
+        char *word = c->pool + (size_t) (cfg->vocab + i) * WORD_LEN;
+        Digest d = hasher_digest(hasher, word, (uint32_t) strlen(word));
+        bf_insert(bf, &d);
+        ht_insert(ht, &d, word, i % 2 ? newspeak : NULL);
+    }
+    hasher_delete(&hasher);
+
+    Dict *dict = automaton ? dict_automaton(ht, backend, salt) : dict_create(ht, bf, backend, salt);
+    Filter *f = dict ? filter_create(dict) : NULL;
+    if (!f) {
+        if (dict)
+            dict_delete(&dict);
+        else {
+            ht_delete(&ht);
+            bf_delete(&bf);
+        }
+        return false;
+    }
+
+    uint64_t best = UINT64_MAX;
+    bool ok = true;
+    for (uint32_t rep = 0; ok && rep < cfg->reps; rep++) {
+        uint64_t start = now_ns();
+        ok = filter_text(f, c->text, c->size);
+        uint64_t elapsed = now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+        if (rep + 1 < cfg->reps)
+            filter_reset(f);
+    }
+    int64_t bytes = heap_bytes() - heap; // the dictionary and the transgressions
+
+    if (ok)
+        report_stage(cfg, "filter", variant, c->count, best, bytes);
+
+    filter_delete(&f);
+    dict_delete(&dict);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    Config cfg = { 1048576, 10000, 50000, 1000000, 100000, 1.0, 0.05, 1, 3, false };
+
+    int c;
+    while ((c = getopt(argc, argv, "hJf:t:n:p:v:z:r:S:R:")) != -1) {
+        switch (c) {
+        case 'J': cfg.json = true; break;
+        case 'f': cfg.bf_len = (uint32_t) atoi(optarg); break;
+        case 't': cfg.ht_len = (uint32_t) atoi(optarg); break;
+        case 'n': cfg.keys = (uint32_t) atoi(optarg); break;
+        case 'p': cfg.tokens = (uint32_t) atoi(optarg); break;
+        case 'v': cfg.vocab = (uint32_t) atoi(optarg); break;
+        case 'z': cfg.skew = atof(optarg); break;
+        case 'r': cfg.hit_rate = atof(optarg); break;
+        case 'S': cfg.seed = strtoull(optarg, NULL, 10); break;
+        case 'R': cfg.reps = (uint32_t) atoi(optarg); break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (!cfg.bf_len || !cfg.ht_len || !cfg.keys || !cfg.tokens || !cfg.vocab || !cfg.reps
+        || cfg.skew < 0 || cfg.hit_rate < 0 || cfg.hit_rate > 1) {
+        fprintf(stderr, "Invalid sizes.\n");
+        return -1;
+    }
+
+    Corpus corpus;
+    if (!corpus_create(&corpus, &cfg)) {
+        fprintf(stderr, "Failed to generate the corpus.\n");
+        return -1;
+    }
+
+    /* what was measured, so results can be compared across runs */
+    if (cfg.json)
+        fprintf(stdout,
+            "{\"config\":{\"bf_size\":%u,\"ht_size\":%u,\"keys\":%u,\"words\":%u,\"vocab\":%u,"
+            "\"skew\":%.3lf,\"hit_rate\":%.4lf,\"seed\":%" PRIu64 ",\"reps\":%u,\"bytes\":%" PRIu64
+            "}}\n",
+            cfg.bf_len, cfg.ht_len, cfg.keys, cfg.tokens, cfg.vocab, cfg.skew, cfg.hit_rate,
+            cfg.seed, cfg.reps, corpus.size);
+    else
+        fprintf(stdout, "%-15s %-26s %10s %14s %12s %12s %12s\n", "stage", "variant", "ns/op",
+            "words/s", "bytes", "fp rate", "expected");
+
+    bench_scan(&cfg, &corpus);
+    bench_lower(&cfg, &corpus);
+    bench_fold(&cfg, &corpus);
+
+    uint64_t salt[2] = { 0x9846e4f157fe8840, 0xc5f318d7e055afb8 };
+    bool ok = true;
+
+    /* hashing and the Bloom filter layouts for each backend */
+    for (uint32_t b = 0; ok && b < NUM_BACKENDS; b++) {
+        Hasher *hasher = hasher_create((HashBackend) b, salt);
+        ok = hasher != NULL;
+        if (ok) {
+            bench_hash(&cfg, &corpus, hasher);
+            ok = bench_bf(&cfg, &corpus, hasher, false) && bench_bf(&cfg, &corpus, hasher, true);
+        }
+        hasher_delete(&hasher);
+    }
+
+    /* the hash table engines and lists with the default backend's digests */
+    Hasher *hasher = ok ? hasher_create(SPECK, salt) : NULL;
+    if (hasher) {
+        for (uint32_t i = 0; i < corpus.count; i++)
+            corpus.digests[i] = hasher_digest(hasher, corpus.words[i], corpus.lengths[i]);
+        ok = bench_ht(&cfg, &corpus, hasher, false, false)
+             && bench_ht(&cfg, &corpus, hasher, false, true)
+             && bench_ht(&cfg, &corpus, hasher, true, false) && bench_ll(&cfg, &corpus, false)
+             && bench_ll(&cfg, &corpus, true) && bench_dafsa(&cfg, &corpus);
+        hasher_delete(&hasher);
+    } else
+        ok = false;
+
+    /* and the whole filter */
+    ok = ok && bench_filter(&cfg, &corpus, SPECK, false, false, false, false)
+         && bench_filter(&cfg, &corpus, SPECK, false, false, true, false)
+         && bench_filter(&cfg, &corpus, WYHASH, true, true, false, false)
+         && bench_filter(&cfg, &corpus, SPECK, false, false, false, true);
+
+    if (!ok)
+        fprintf(stderr, "Failed to allocate memory for a benchmark.\n");
+
+    corpus_delete(&corpus);
+    return ok ? 0 : -1;
+}
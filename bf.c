@@ -1,46 +1,71 @@
 #include "bf.h"
 
 #include "bv.h"
-#include "speck.h"
+#include "hash.h"
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define NUM_SALTS 3 // total num of salts
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-/* tracks number of bits set in the BV (to be used by bf_count) */
-static uint32_t bit_count = 0;
+#define BLOCK_BYTES 64 // one cache line
+#define BLOCK_BITS  (BLOCK_BYTES * 8)
+#define BLOCK_LANES (BLOCK_BYTES / sizeof(uint64_t)) // one bit is set per 64 bit lane
+#define COUNTER_MAX 15 // 4 bit counters saturate here (and are never decremented again)
 
-/* credits: provided in the lab documentation */
-/* BloomFilter (BF) definition */
+/* odd multipliers that pick the bit of each lane in a block (from Impala's split block filter) */
+static const uint32_t lane_salt[BLOCK_LANES] = { 0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+    0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31 };
+
+/* credits: based on the definition provided in the lab documentation */
+/* BloomFilter (BF) definition. the salts are gone: indices come from the word's digest */
 struct BloomFilter {
-    uint64_t primary[2]; // salts for the hash function
-    uint64_t secondary[2];
-    uint64_t tertiary[2];
-    BitVector *filter; // the underlying BitVector (BV)
+    BitVector *filter; // the underlying BitVector (BV), standard layout
+    uint64_t *blocks; // cache line blocks (blocked layout), NULL otherwise
+    uint32_t num_blocks; // number of blocks
+    uint32_t bit_count; // tracks number of bits set (to be used by bf_count)
+    bool owned; // false if the bits belong to someone else (see bf_wrap)
+    uint8_t *counters; // 4 bit counter per bit, two per byte (counting BF), NULL otherwise
 };
 
+/* returns the number of bits a BF of size bits really has (blocked ones are rounded up to whole blocks) */
+uint64_t bf_rounded(uint32_t size, bool blocked) {
+    if (!blocked)
+        return size;
+    return ((uint64_t) size + BLOCK_BITS - 1) / BLOCK_BITS * BLOCK_BITS;
+}
+
 /* credits: provided in the lab documentation */
-/* constructor for the BF */
-BloomFilter *bf_create(uint32_t size) {
+/* constructor for the BF. blocked keeps all bits of a word in one cache line */
+BloomFilter *bf_create(uint32_t size, bool blocked) {
     BloomFilter *bf = (BloomFilter *) malloc(sizeof(BloomFilter));
 
     if (bf) {
-        /* salts from the lab doc */
-        bf->primary[0] = 0x5adf08ae86d36f21;
-        bf->primary[1] = 0xa267bbd3116f3957;
-
-        bf->secondary[0] = 0x419d292ea2ffd49e;
-        bf->secondary[1] = 0x09601433057d5786;
+        bf->filter = NULL;
+        bf->blocks = NULL;
+        bf->num_blocks = 0;
+        bf->bit_count = 0;
+        bf->owned = true;
+        bf->counters = NULL;
 
-        bf->tertiary[0] = 0x50d8bb08de3818df;
-        bf->tertiary[1] = 0x4deaae187c16ae1d;
+        /* make the cache aligned blocks (size rounded up to whole blocks, whose bits must fit bf_size) */
+        if (blocked && bf_rounded(size, blocked) <= UINT32_MAX) {
+            bf->num_blocks = (uint32_t) (bf_rounded(size, blocked) / BLOCK_BITS);
+            bf->blocks = (uint64_t *) aligned_alloc(BLOCK_BYTES, (size_t) bf->num_blocks * BLOCK_BYTES);
+            if (bf->blocks)
+                memset(bf->blocks, 0, (size_t) bf->num_blocks * BLOCK_BYTES);
+        }
 
         /* make the bit vector */
-        bf->filter = bv_create(size);
-        if (!bf->filter) {
+        else if (!blocked)
+            bf->filter = bv_create(size);
+
+        if (!bf->filter && !bf->blocks) {
             free(bf);
             bf = NULL;
         }
@@ -49,41 +74,194 @@ BloomFilter *bf_create(uint32_t size) {
     return bf;
 }
 
+/*
+ * constructor for a BF over bits laid out by another BF (see bf_data) that
+ * has size bits, count of them set. the bits may be read only (e.g. mapped
+ * from a file) and are not freed by bf_delete. blocked bits must be 64 byte
+ * aligned.
+ */
+BloomFilter *bf_wrap(void *data, uint32_t size, uint32_t count, bool blocked) {
+    BloomFilter *bf = (BloomFilter *) malloc(sizeof(BloomFilter));
+
+    if (bf) {
+        bf->filter = NULL;
+        bf->blocks = NULL;
+        bf->num_blocks = 0;
+        bf->bit_count = count;
+        bf->owned = false;
+        bf->counters = NULL;
+
+        if (blocked) {
+            bf->blocks = (uint64_t *) data;
+            bf->num_blocks = size / BLOCK_BITS;
+        } else
+            bf->filter = bv_wrap(size, (uint8_t *) data);
+
+        if ((!bf->filter && !bf->blocks) || (blocked && !bf->num_blocks)) {
+            bv_delete(&(bf->filter));
+            free(bf);
+            return NULL;
+        }
+    }
+
+    return bf;
+}
+
+/*
+ * constructor for a counting BF: next to every bit a 4 bit counter of the
+ * words that set it, so words can be removed (bf_remove). the bits are kept
+ * as well, so probing costs the same as in a plain BF of the same layout. a
+ * counter that reaches COUNTER_MAX sticks there (its bit is never cleared),
+ * which can only leave a false positive, never a false negative.
+ */
+BloomFilter *bf_create_counting(uint32_t size, bool blocked) {
+    BloomFilter *bf = bf_create(size, blocked);
+
+    if (bf) {
+        bf->counters = (uint8_t *) calloc(bf_size(bf) / 2 + 1, sizeof(uint8_t));
+        if (!bf->counters)
+            bf_delete(&bf);
+    }
+
+    return bf;
+}
+
 /* destructor for the BF */
 void bf_delete(BloomFilter **bf) {
-    if (bf && *bf && (*bf)->filter) {
-        bit_count = 0; // reset the bit count (for bf_count)
-        bv_delete(&((*bf)->filter)); // delete the BV
+    if (bf && *bf) {
+        if ((*bf)->filter)
+            bv_delete(&((*bf)->filter)); // delete the BV
+        if ((*bf)->owned)
+            free((*bf)->blocks);
+        free((*bf)->counters);
         free(*bf);
         *bf = NULL;
     }
     return;
 }
 
+/* returns the bits of the BF and their size in bytes (to save them, see bf_wrap) */
+void *bf_data(BloomFilter *bf, uint32_t *bytes) {
+    if (!bf)
+        return NULL;
+    if (bf->blocks) {
+        *bytes = (uint32_t) ((uint64_t) bf->num_blocks * BLOCK_BYTES);
+        return bf->blocks;
+    }
+    return bv_data(bf->filter, bytes);
+}
+
 /* returns the size of the BF */
 uint32_t bf_size(BloomFilter *bf) {
     if (!bf)
         return 0; // no BF
+    if (bf->blocks)
+        return (uint32_t) ((uint64_t) bf->num_blocks * BLOCK_BITS); // at most UINT32_MAX (see bf_create)
     return bv_length(bf->filter); // size == length of the underlying BV
 }
 
-/* adds the word oldspeak to the BF */
-void bf_insert(BloomFilter *bf, char *oldspeak) {
-    if (!bf || !oldspeak)
+/* returns true if the BF uses the blocked layout */
+bool bf_blocked(BloomFilter *bf) {
+    return bf && bf->blocks;
+}
+
+/* returns true if the BF counts its bits (see bf_create_counting) */
+bool bf_counting(BloomFilter *bf) {
+    return bf && bf->counters;
+}
+
+/* helper function that increments the counter of bit i. returns true if it was 0 */
+static inline bool counter_up(BloomFilter *bf, uint32_t i) {
+    uint8_t *c = &(bf->counters[i / 2]);
+    uint32_t shift = (i % 2) * 4;
+    uint32_t n = (*c >> shift) & 0xF;
+
+    if (n < COUNTER_MAX)
+        *c = (uint8_t) ((*c & ~(0xF << shift)) | ((n + 1) << shift));
+    return n == 0;
+}
+
+/* helper function that decrements the counter of bit i. returns true if it dropped to 0 */
+static inline bool counter_down(BloomFilter *bf, uint32_t i) {
+    uint8_t *c = &(bf->counters[i / 2]);
+    uint32_t shift = (i % 2) * 4;
+    uint32_t n = (*c >> shift) & 0xF;
+
+    if (n == 0 || n == COUNTER_MAX)
+        return false; // not set, or saturated: its true count is lost
+    *c = (uint8_t) ((*c & ~(0xF << shift)) | ((n - 1) << shift));
+    return n == 1;
+}
+
+/* helper function that builds the one-bit-per-lane mask of a digest and returns its block */
+static inline uint64_t *block_mask(BloomFilter *bf, Digest *d, uint64_t mask[]) {
+    uint32_t key = (uint32_t) d->hi;
+    for (uint32_t i = 0; i < BLOCK_LANES; i++)
+        mask[i] = (uint64_t) 1 << ((key * lane_salt[i]) >> 26); // top 6 bits pick the bit
+    return bf->blocks + (d->lo % bf->num_blocks) * BLOCK_LANES;
+}
+
+/* helper function that checks if all the bits of mask are set in the block */
+static inline bool block_test(const uint64_t *block, const uint64_t mask[]) {
+#if defined(__AVX2__)
+    /* two 32 byte loads cover the cache line */
+    __m256i m0 = _mm256_loadu_si256((const __m256i *) mask);
+    __m256i m1 = _mm256_loadu_si256((const __m256i *) (mask + 4));
+    __m256i b0 = _mm256_load_si256((const __m256i *) block);
+    __m256i b1 = _mm256_load_si256((const __m256i *) (block + 4));
+    return _mm256_testc_si256(b0, m0) && _mm256_testc_si256(b1, m1);
+#elif defined(__SSE2__)
+    /* four 16 byte loads: (block & mask) == mask in every byte */
+    __m128i all = _mm_set1_epi8(-1);
+    for (uint32_t i = 0; i < BLOCK_LANES; i += 2) {
+        __m128i m = _mm_loadu_si128((const __m128i *) (mask + i));
+        __m128i b = _mm_load_si128((const __m128i *) (block + i));
+        all = _mm_and_si128(all, _mm_cmpeq_epi8(_mm_and_si128(b, m), m));
+    }
+    return _mm_movemask_epi8(all) == 0xFFFF;
+#else
+    uint64_t missing = 0;
+    for (uint32_t i = 0; i < BLOCK_LANES; i++)
+        missing |= mask[i] & ~block[i];
+    return !missing;
+#endif
+}
+
+/* adds the word with digest d to the BF */
+void bf_insert(BloomFilter *bf, Digest *d) {
+    if (!bf || !d)
         return; // safety check
 
+    /* blocked: set one bit in each lane of the word's block */
+    if (bf->blocks) {
+        uint64_t mask[BLOCK_LANES];
+        uint64_t *block = block_mask(bf, d, mask);
+        for (uint32_t i = 0; i < BLOCK_LANES; i++) {
+            if (bf->counters) {
+                uint32_t bit = (uint32_t) (block - bf->blocks + i) * 64 + __builtin_ctzll(mask[i]);
+                counter_up(bf, bit);
+            }
+            if (!(block[i] & mask[i])) {
+                bf->bit_count++;
+                block[i] |= mask[i];
+            }
+        }
+        return;
+    }
+
     uint32_t index, size = bf_size(bf);
-    uint64_t *salt[NUM_SALTS]
-        = { bf->primary, bf->secondary, bf->tertiary }; // temporary salt pointer storing array
 
-    // for each salt
-    for (uint8_t i = 0; i < NUM_SALTS; i++) {
+    // for each index derived from the digest
+    for (uint32_t i = 0; i < DIGEST_BF_PROBES; i++) {
+
+        /* get the ith index by double hashing */
+        index = digest_index(d, i) % size;
 
-        /* get the index by hashing with ith salt */
-        index = hash(salt[i], oldspeak) % size;
+        if (bf->counters)
+            counter_up(bf, index);
 
         if (!bv_get_bit(bf->filter, index)) { // if the bit is not set already
-            bit_count++; // bit wasnt set. now newly added (for bf_count)
+            bf->bit_count++; // bit wasnt set. now newly added (for bf_count)
             bv_set_bit(bf->filter, index); // set the bit @ index in the bv
         }
     }
@@ -91,19 +269,61 @@ void bf_insert(BloomFilter *bf, char *oldspeak) {
     return;
 }
 
-/* checks if the word oldspeak has been added to the BF */
-bool bf_probe(BloomFilter *bf, char *oldspeak) {
-    if (!bf || !oldspeak)
+/*
+ * removes the word with digest d from a counting BF (nothing happens to
+ * other BFs). the word must have been inserted (once for each removal), or
+ * the counts of other words are taken away.
+ */
+void bf_remove(BloomFilter *bf, Digest *d) {
+    if (!bf || !d || !bf->counters)
+        return; // safety check
+
+    /* blocked: one bit in each lane of the word's block */
+    if (bf->blocks) {
+        uint64_t mask[BLOCK_LANES];
+        uint64_t *block = block_mask(bf, d, mask);
+        for (uint32_t i = 0; i < BLOCK_LANES; i++) {
+            uint32_t bit = (uint32_t) (block - bf->blocks + i) * 64 + __builtin_ctzll(mask[i]);
+            if (counter_down(bf, bit)) {
+                bf->bit_count--;
+                block[i] &= ~mask[i];
+            }
+        }
+        return;
+    }
+
+    uint32_t size = bf_size(bf);
+
+    /* a bit is cleared once no word sets it any more */
+    for (uint32_t i = 0; i < DIGEST_BF_PROBES; i++) {
+        uint32_t index = digest_index(d, i) % size;
+        if (counter_down(bf, index)) {
+            bf->bit_count--;
+            bv_clr_bit(bf->filter, index);
+        }
+    }
+
+    return;
+}
+
+/* checks if the word with digest d has been added to the BF */
+bool bf_probe(BloomFilter *bf, Digest *d) {
+    if (!bf || !d)
         return false; // safety check
 
+    /* blocked: one cache line holds every bit of the word */
+    if (bf->blocks) {
+        uint64_t mask[BLOCK_LANES];
+        uint64_t *block = block_mask(bf, d, mask);
+        return block_test(block, mask);
+    }
+
     uint32_t index, size = bf_size(bf);
-    uint64_t *salt[NUM_SALTS]
-        = { bf->primary, bf->secondary, bf->tertiary }; // temporary salt pointer storing array
 
-    // with each salt
-    for (uint8_t i = 0; i < NUM_SALTS; i++) {
-        /* get the index by hashing with ith salt */
-        index = hash(salt[i], oldspeak) % size;
+    // with each index derived from the digest
+    for (uint32_t i = 0; i < DIGEST_BF_PROBES; i++) {
+        /* get the ith index by double hashing */
+        index = digest_index(d, i) % size;
         if (!bv_get_bit(bf->filter, index))
             return false; // bit not set therefore not added
     }
@@ -111,16 +331,87 @@ bool bf_probe(BloomFilter *bf, char *oldspeak) {
     return true; // all bits set
 }
 
+/* helper function that starts loading the bits of the word with digest d into the cache */
+static inline void bf_prefetch(BloomFilter *bf, Digest *d) {
+    if (bf->blocks) {
+        __builtin_prefetch(bf->blocks + (d->lo % bf->num_blocks) * BLOCK_LANES);
+        return;
+    }
+
+    uint32_t size = bf_size(bf);
+    uint8_t *bits = bv_data(bf->filter, NULL);
+    for (uint32_t i = 0; i < DIGEST_BF_PROBES; i++)
+        __builtin_prefetch(bits + (digest_index(d, i) % size) / 8);
+}
+
+/*
+ * checks n words at once, setting hits[i] to bf_probe(bf, &d[i]). the loads
+ * of every word's bits are started before any of them is tested, so the
+ * cache misses of the batch overlap instead of stalling one after another.
+ */
+void bf_probe_batch(BloomFilter *bf, Digest *d, uint32_t n, bool *hits) {
+    if (!bf || !d || !hits)
+        return; // safety check
+
+    for (uint32_t i = 0; i < n; i++)
+        bf_prefetch(bf, &d[i]);
+
+    for (uint32_t i = 0; i < n; i++)
+        hits[i] = bf_probe(bf, &d[i]);
+
+    return;
+}
+
 /* returns number of bits set in the BF */
 uint32_t bf_count(BloomFilter *bf) {
     if (!bf)
         return 0; // safety check
-    return bit_count; // the variable that has been tracking the bit count
+    return bf->bit_count; // the variable that has been tracking the bit count
+}
+
+/*
+ * returns the false positive rate expected from the bits currently set:
+ * (load)^k for the standard layout. for the blocked layout it is the mean
+ * over blocks of the product of each lane's load, since a word only
+ * ever looks at its own block.
+ */
+double bf_fp_rate(BloomFilter *bf) {
+    if (!bf || !bf_size(bf))
+        return 0;
+
+    if (bf->blocks) {
+        double sum = 0;
+        for (uint32_t b = 0; b < bf->num_blocks; b++) {
+            double p = 1;
+            for (uint32_t i = 0; i < BLOCK_LANES; i++)
+                p *= __builtin_popcountll(bf->blocks[b * BLOCK_LANES + i]) / 64.0;
+            sum += p;
+        }
+        return sum / bf->num_blocks;
+    }
+
+    double load = (double) bf_count(bf) / bf_size(bf), p = 1;
+    for (uint32_t i = 0; i < DIGEST_BF_PROBES; i++)
+        p *= load;
+    return p;
 }
 
 /* prints the BF */
 void bf_print(BloomFilter *bf) {
-    if (bf)
+    if (!bf)
+        return;
+
+    if (bf->filter) {
         bv_print(bf->filter); // print the bv
+        return;
+    }
+
+    /* print the blocks like a bv (highest bit first) */
+    uint32_t i = bf_size(bf);
+    while (i >= 1) {
+        i--;
+        fprintf(stdout, "%c", (bf->blocks[i / 64] >> (i % 64)) & 1 ? '1' : '0');
+    }
+    fprintf(stdout, "\n");
     return;
 }
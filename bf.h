@@ -2,24 +2,43 @@
 #define __BF_H__
 
 #include "bv.h"
+#include "hash.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 
 typedef struct BloomFilter BloomFilter;
 
-BloomFilter *bf_create(uint32_t size);
+uint64_t bf_rounded(uint32_t size, bool blocked);
+
+BloomFilter *bf_create(uint32_t size, bool blocked);
+
+BloomFilter *bf_create_counting(uint32_t size, bool blocked);
+
+BloomFilter *bf_wrap(void *data, uint32_t size, uint32_t count, bool blocked);
 
 void bf_delete(BloomFilter **bf);
 
 uint32_t bf_size(BloomFilter *bf);
 
-void bf_insert(BloomFilter *bf, char *oldspeak);
+bool bf_blocked(BloomFilter *bf);
+
+bool bf_counting(BloomFilter *bf);
+
+void *bf_data(BloomFilter *bf, uint32_t *bytes);
 
-bool bf_probe(BloomFilter *bf, char *oldspeak);
+void bf_insert(BloomFilter *bf, Digest *d);
+
+void bf_remove(BloomFilter *bf, Digest *d);
+
+bool bf_probe(BloomFilter *bf, Digest *d);
+
+void bf_probe_batch(BloomFilter *bf, Digest *d, uint32_t n, bool *hits);
 
 uint32_t bf_count(BloomFilter *bf);
 
+double bf_fp_rate(BloomFilter *bf);
+
 void bf_print(BloomFilter *bf);
 
 #endif
@@ -1,5 +1,6 @@
 #include "bv.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,6 +11,7 @@
 struct BitVector {
     uint32_t length; // length in bits
     uint8_t *vector;
+    bool owned; // false if vector belongs to someone else (see bv_wrap)
 };
 
 /* constructor for a BitVector */
@@ -18,6 +20,7 @@ BitVector *bv_create(uint32_t length) {
 
     if (v) {
         v->length = length;
+        v->owned = true;
 
         uint32_t min_elems
             = length / BYTE + 1; // to get size for array (credits: based on lab5 doc)
@@ -36,16 +39,39 @@ BitVector *bv_create(uint32_t length) {
     return v;
 }
 
+/* constructor for a BitVector over existing memory (length / BYTE + 1 bytes) */
+/* the memory is not freed by bv_delete and may be read only */
+BitVector *bv_wrap(uint32_t length, uint8_t *vector) {
+    BitVector *v = (BitVector *) malloc(sizeof(BitVector));
+
+    if (v) {
+        v->length = length;
+        v->vector = vector;
+        v->owned = false;
+    }
+    return v;
+}
+
 /* destructor for a BitVector */
 void bv_delete(BitVector **v) {
     if (*v && (*v)->vector) {
-        free((*v)->vector);
+        if ((*v)->owned)
+            free((*v)->vector);
         free(*v);
         *v = NULL;
     }
     return;
 }
 
+/* returns the bytes of the BitVector and their count */
+uint8_t *bv_data(BitVector *v, uint32_t *bytes) {
+    if (!v)
+        return NULL;
+    if (bytes)
+        *bytes = v->length / BYTE + 1; // same as in bv_create
+    return v->vector;
+}
+
 /* return BV length (in bits) */
 uint32_t bv_length(BitVector *v) {
     if (!v)
@@ -7,10 +7,14 @@ typedef struct BitVector BitVector;
 
 BitVector *bv_create(uint32_t length);
 
+BitVector *bv_wrap(uint32_t length, uint8_t *vector);
+
 void bv_delete(BitVector **bv);
 
 uint32_t bv_length(BitVector *bv);
 
+uint8_t *bv_data(BitVector *bv, uint32_t *bytes);
+
 void bv_set_bit(BitVector *bv, uint32_t i);
 
 void bv_clr_bit(BitVector *bv, uint32_t i);
@@ -0,0 +1,63 @@
+#!/bin/sh
+# regression cases for banhammer: runs ./banhammer on small word files and reports every wrong answer
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+bin=$(pwd)/banhammer
+fail=0
+
+# helper that keeps the transgressions of banhammer's output, on one line
+reported() {
+    sed -n '/:$/,$p' | sed '1,2d' | tr '\n' ' '
+}
+
+# helper that prints n bytes of filler words (w w w ...)
+filler() {
+    awk -v n="$1" 'BEGIN { for (; n > 1; n -= 2) printf "w "; if (n) printf " " }'
+}
+
+# expect name flags input words: the transgressions banhammer reports for input, from a file and from a pipe ("" for none)
+expect() {
+    printf '%s\n' "$3" > "$dir/in.txt"
+    for from in file pipe; do
+        if [ $from = file ]; then
+            got=$(cd "$dir" && "$bin" $2 < in.txt | reported)
+        else
+            got=$(cd "$dir" && cat in.txt | "$bin" $2 | reported)
+        fi
+        if [ "$got" != "$4" ]; then
+            echo "$1 ($from): expected \"$4\", got \"$got\""
+            fail=1
+        fi
+    done
+}
+
+printf 'bad\nshit\ngod\nits\nwell\nshell\ncoop\n' > "$dir/badspeak.txt"
+printf 'good nice\n' > "$dir/newspeak.txt"
+
+expect "-n plain words" -n "a good day, it's fine, we'll see, she'll go, co-op store" "good->nice "
+expect "-n obfuscated words" -n "b4d baaaad b.a.d sh1t g0d" "bad shit god "
+expect "-n obfuscated newspeak" -n "g00d goood" "good->nice "
+
+# an obfuscated word ending on the first chunk's last byte (2^20) is not cut in two
+expect "-n b.a.d across a chunk" -n "$(filler 1048571)b.a.d $(filler 100)" "bad "
+expect "-n sh!t across a chunk" -n "$(filler 1048572)sh!t $(filler 100)" "shit "
+
+# nor is one where the threads' chunks meet, so -j finds what one thread does
+parity="$(filler 1992) b.a.d $(filler 2008)"
+expect "-n b.a.d with one thread" -n "$parity" "bad "
+expect "-n b.a.d with two threads" "-n -j 2" "$parity" "bad "
+
+# the words are those of the lab's pattern [a-zA-Z0-9_]+([-']?[a-zA-Z0-9_])*, however the scanner finds them
+printf "it's\nco-op\nit\ns\nco\nop\na\nb\nx\ny\nbad\n_a_\n9z\nz\n" > "$dir/badspeak.txt"
+: > "$dir/newspeak.txt"
+
+expect "single joiners" "" "it's co-op" "it's co-op "
+expect "double joiners" "" "a--b x''y" "a b x y "
+expect "trailing joiners" "" "bad- x' y-" "bad x y "
+expect "underscores and digits" "" "_a_ 9z" "_a_ 9z "
+expect "words across SIMD blocks" "" "$(filler 14)bad $(filler 13)co-op $(filler 25)it's" "bad co-op it's "
+expect "a line longer than 4096 bytes" "" "$(filler 4094)bad $(filler 5000)_a_" "bad _a_ "
+
+[ $fail = 0 ] && echo "all checks passed"
+exit $fail
@@ -0,0 +1,258 @@
+#include "server.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* one connection of the load and the latencies it measured */
+typedef struct Conn {
+    const char *path; // socket of the daemon
+    const char *text; // the request sent (all requests are the same)
+    uint32_t size;
+    uint32_t requests; // requests to send
+    uint64_t *latency; // ns of each request
+    uint32_t done; // requests answered
+    uint32_t errors; // requests answered with SERVER_ERROR
+    bool print; // print the first response
+} Conn;
+
+/* helper function to print usage */
+static void usage(char *argv) {
+    fprintf(stdout,
+        "SYNOPSIS\n"
+        "  Load generator for the banhammer daemon (banhammer -u).\n"
+        "  Sends stdin as a request over and over on several connections\n"
+        "  and reports the throughput and the p50/p99 latency.\n"
+        "\n"
+        "USAGE\n"
+        "  %s [-hv] [-n requests] [-c connections] -u socket\n"
+        "\n"
+        "OPTIONS\n"
+        "  -h             Program usage and help.\n"
+        "  -v             Print the response to the first request.\n"
+        "  -n requests    Requests sent in all (default: 10000).\n"
+        "  -c connections Connections sending at once, one thread each (default: 1).\n"
+        "  -u socket      Unix domain socket the daemon serves on.\n",
+        argv);
+}
+
+/* helper function for a monotonic time stamp in ns */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/* helper function that connects to the daemon. returns -1 if it cannot */
+static int connect_to(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* helper function that prints a response like banhammer lists the transgressions */
+static void print_response(uint8_t verdict, const char *body, uint32_t size) {
+    fprintf(stdout, "Verdict:%s%s%s%s\n", verdict & SERVER_THOUGHTCRIME ? " thoughtcrime" : "",
+        verdict & SERVER_RIGHTCRIME ? " rightcrime" : "", verdict & SERVER_ERROR ? " error" : "",
+        verdict ? "" : " none");
+    fwrite(body, 1, size, stdout);
+    if (verdict & SERVER_ERROR)
+        fprintf(stdout, "\n");
+}
+
+/* thread function: sends the requests of a connection one after another */
+static void *conn_run(void *arg) {
+    Conn *c = (Conn *) arg;
+    char *body = NULL; // body of the response
+    uint32_t capacity = 0;
+    uint8_t header[4];
+
+    int fd = connect_to(c->path);
+    if (fd < 0)
+        return NULL;
+
+    server_pack(header, c->size);
+
+    while (c->done < c->requests) {
+        uint64_t start = now_ns();
+
+        /* send the request, then read the response */
+        if (!server_send(fd, header, sizeof(header)) || !server_send(fd, c->text, c->size))
+            break;
+
+        uint8_t reply[4], verdict;
+        if (!server_recv(fd, reply, sizeof(reply)) || !server_unpack(reply)
+            || !server_recv(fd, &verdict, 1))
+            break;
+
+        uint32_t size = server_unpack(reply) - 1;
+        if (size > capacity) {
+            char *grown = (char *) realloc(body, size);
+            if (!grown)
+                break;
+            body = grown;
+            capacity = size;
+        }
+        if (!server_recv(fd, body, size))
+            break;
+
+        c->latency[c->done++] = now_ns() - start;
+
+        if (c->print && c->done == 1)
+            print_response(verdict, body, size);
+
+        /* the daemon closes the connection after an error */
+        if (verdict & SERVER_ERROR) {
+            c->errors++;
+            break;
+        }
+    }
+
+    close(fd);
+    free(body);
+    return NULL;
+}
+
+/* helper function for qsort of latencies */
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    uint32_t requests = 10000;
+    uint32_t conns = 1;
+    char *path = NULL;
+    bool print = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "hvn:c:u:")) != -1) {
+        switch (c) {
+        case 'v': print = true; break;
+        case 'n': requests = (uint32_t) atoi(optarg); break;
+        case 'c': conns = (uint32_t) atoi(optarg); break;
+        case 'u': path = optarg; break;
+        case 'h': usage(argv[0]); return 0;
+        default: usage(argv[0]); return -1;
+        }
+    }
+
+    if (!path || !requests || !conns || conns > requests) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    /* the request is all of stdin */
+    char *text = NULL;
+    size_t size = 0, capacity = 0;
+    while (true) {
+        if (size == capacity) {
+            capacity = capacity ? 2 * capacity : 65536;
+            char *grown = capacity <= SERVER_MAX_TEXT ? (char *) realloc(text, capacity) : NULL;
+            if (!grown) {
+                fprintf(stderr, "Request too large.\n");
+                free(text);
+                return -1;
+            }
+            text = grown;
+        }
+        ssize_t n = read(STDIN_FILENO, text + size, capacity - size);
+        if (n <= 0)
+            break;
+        size += (size_t) n;
+    }
+
+    Conn *conn = (Conn *) calloc(conns, sizeof(Conn));
+    pthread_t *threads = (pthread_t *) malloc(conns * sizeof(pthread_t));
+    bool *started = (bool *) malloc(conns * sizeof(bool)); // false if the connection ran on this thread
+    uint64_t *latency = (uint64_t *) malloc((size_t) requests * sizeof(uint64_t));
+    if (!conn || !threads || !started || !latency) {
+        fprintf(stderr, "Failed to allocate memory for the connections.\n");
+        free(text);
+        free(conn);
+        free(threads);
+        free(started);
+        free(latency);
+        return -1;
+    }
+
+    /* every connection sends its share of the requests (they are timed into one array) */
+    uint64_t start = now_ns();
+    for (uint32_t i = 0, first = 0; i < conns; i++) {
+        conn[i].path = path;
+        conn[i].text = text;
+        conn[i].size = (uint32_t) size;
+        conn[i].requests = requests / conns + (i < requests % conns);
+        conn[i].latency = latency + first;
+        conn[i].print = print && !i;
+        first += conn[i].requests;
+
+        started[i] = !pthread_create(&threads[i], NULL, conn_run, &conn[i]);
+        if (!started[i])
+            conn_run(&conn[i]);
+    }
+
+    for (uint32_t i = 0; i < conns; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    /* pack the measured latencies together */
+    uint32_t done = 0, errors = 0;
+    for (uint32_t i = 0; i < conns; i++) {
+        memmove(latency + done, conn[i].latency, conn[i].done * sizeof(uint64_t));
+        done += conn[i].done;
+        errors += conn[i].errors;
+    }
+
+    if (!done) {
+        fprintf(stderr, "Failed to get responses from %s.\n", path);
+        free(text);
+        free(conn);
+        free(threads);
+        free(started);
+        free(latency);
+        return -1;
+    }
+
+    qsort(latency, done, sizeof(uint64_t), compare);
+
+    double seconds = elapsed / 1e9;
+    fprintf(stdout, "Requests: %u answered of %u (%u errors)\n", done, requests, errors);
+    fprintf(stdout, "Connections: %u\n", conns);
+    fprintf(stdout, "Throughput: %0.1lf requests/s (%0.1lf MB/s)\n", done / seconds,
+        done * (double) size / seconds / 1e6);
+    fprintf(stdout, "Latency p50: %0.1lf us\n", latency[(done - 1) / 2] / 1e3);
+    fprintf(stdout, "Latency p99: %0.1lf us\n", latency[(uint64_t) (done - 1) * 99 / 100] / 1e3);
+    fprintf(stdout, "Latency max: %0.1lf us\n", latency[done - 1] / 1e3);
+
+    free(text);
+    free(conn);
+    free(threads);
+    free(started);
+    free(latency);
+    return 0;
+}
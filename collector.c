@@ -0,0 +1,172 @@
+#include "collector.h"
+
+#include "dict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * A Collector is the set of dictionary words found in the input, kept in the
+ * order they were first seen. a word's dictionary entry is unique and does
+ * not move while filtering, so the address of its oldspeak identifies it: the
+ * set is an open addressing table of those addresses, and nothing is copied.
+ */
+
+#define MIN_SLOTS 64 // initial table size (a power of 2)
+
+/* Collector definition */
+struct Collector {
+    Match *matches; // words in first-seen order
+    uint32_t count; // number of words
+    uint32_t capacity; // matches allocated
+    uint32_t *slots; // index + 1 of a word in matches (0 if the slot is empty)
+    uint32_t size; // number of slots (a power of 2, at least twice count)
+};
+
+/* constructor for a Collector */
+Collector *collector_create(void) {
+    Collector *c = (Collector *) malloc(sizeof(Collector));
+
+    if (c) {
+        c->matches = NULL;
+        c->count = 0;
+        c->capacity = 0;
+        c->size = MIN_SLOTS;
+        c->slots = (uint32_t *) calloc(c->size, sizeof(uint32_t));
+        if (!c->slots) {
+            free(c);
+            c = NULL;
+        }
+    }
+
+    return c;
+}
+
+/* destructor for a Collector */
+void collector_delete(Collector **c) {
+    if (c && *c) {
+        free((*c)->matches);
+        free((*c)->slots);
+        free(*c);
+        *c = NULL;
+    }
+    return;
+}
+
+/* helper function that returns the home slot of an entry's address */
+static inline uint32_t home(const char *oldspeak, uint32_t size) {
+    uint64_t key = (uint64_t) (uintptr_t) oldspeak * 0x9e3779b97f4a7c15; // spread the address bits
+    return (uint32_t) (key >> 32) & (size - 1);
+}
+
+/* helper function that doubles the slots and puts every word back in */
+static bool grow(Collector *c) {
+    uint32_t size = c->size * 2;
+    uint32_t *slots = (uint32_t *) calloc(size, sizeof(uint32_t));
+    if (!slots)
+        return false;
+
+    for (uint32_t i = 0; i < c->count; i++) {
+        uint32_t pos = home(c->matches[i].oldspeak, size);
+        while (slots[pos])
+            pos = (pos + 1) & (size - 1);
+        slots[pos] = i + 1;
+    }
+
+    free(c->slots);
+    c->slots = slots;
+    c->size = size;
+    return true;
+}
+
+/* adds a dictionary word to the Collector if it is not in it yet. returns false if out of memory */
+bool collector_add(Collector *c, Match *m) {
+    if (!c || !m)
+        return false;
+
+    uint32_t pos = home(m->oldspeak, c->size);
+    for (; c->slots[pos]; pos = (pos + 1) & (c->size - 1)) {
+        if (c->matches[c->slots[pos] - 1].oldspeak == m->oldspeak)
+            return true; // seen already
+    }
+
+    if (c->count == c->capacity) {
+        uint32_t capacity = c->capacity ? 2 * c->capacity : MIN_SLOTS / 2;
+        Match *matches = (Match *) realloc(c->matches, capacity * sizeof(Match));
+        if (!matches)
+            return false;
+        c->matches = matches;
+        c->capacity = capacity;
+    }
+
+    c->matches[c->count] = *m;
+    c->slots[pos] = ++c->count;
+
+    /* keep the table at most half full */
+    if (2 * c->count > c->size)
+        return grow(c);
+
+    return true;
+}
+
+/* returns the number of words in the Collector */
+uint32_t collector_count(Collector *c) {
+    return c ? c->count : 0;
+}
+
+/* returns the ith word seen (0 is the first), NULL if there are not that many */
+Match *collector_get(Collector *c, uint32_t i) {
+    return c && i < c->count ? &(c->matches[i]) : NULL;
+}
+
+/* adds the words of from to to (in from's order). returns false if out of memory */
+bool collector_merge(Collector *to, Collector *from) {
+    if (!to || !from)
+        return false;
+
+    for (uint32_t i = 0; i < from->count; i++) {
+        if (!collector_add(to, &(from->matches[i])))
+            return false;
+    }
+    return true;
+}
+
+/* returns the bytes the Collector holds (its words and slots, for stats) */
+size_t collector_bytes(Collector *c) {
+    if (!c)
+        return 0;
+    return sizeof(Collector) + (size_t) c->capacity * sizeof(Match)
+           + (size_t) c->size * sizeof(uint32_t);
+}
+
+/* empties the Collector. only the slots of its words are touched, so it costs O(words) */
+void collector_clear(Collector *c) {
+    if (!c)
+        return;
+
+    for (uint32_t i = 0; i < c->count; i++) {
+        uint32_t pos = home(c->matches[i].oldspeak, c->size);
+        while (c->slots[pos] != i + 1)
+            pos = (pos + 1) & (c->size - 1);
+        c->slots[pos] = 0;
+    }
+
+    c->count = 0;
+    return;
+}
+
+/* prints the words in the order they were first seen (like node_print) */
+void collector_print(Collector *c) {
+    if (!c)
+        return;
+
+    for (uint32_t i = 0; i < c->count; i++) {
+        if (c->matches[i].newspeak)
+            fprintf(stdout, "%s->%s\n", c->matches[i].oldspeak, c->matches[i].newspeak);
+        else
+            fprintf(stdout, "%s\n", c->matches[i].oldspeak);
+    }
+    return;
+}
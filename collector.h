@@ -0,0 +1,30 @@
+#ifndef __COLLECTOR_H__
+#define __COLLECTOR_H__
+
+#include "dict.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Collector Collector;
+
+Collector *collector_create(void);
+
+void collector_delete(Collector **c);
+
+bool collector_add(Collector *c, Match *m);
+
+uint32_t collector_count(Collector *c);
+
+Match *collector_get(Collector *c, uint32_t i);
+
+bool collector_merge(Collector *to, Collector *from);
+
+size_t collector_bytes(Collector *c);
+
+void collector_clear(Collector *c);
+
+void collector_print(Collector *c);
+
+#endif
@@ -0,0 +1,543 @@
+#include "dafsa.h"
+
+#include "ht.h"
+#include "node.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * A Dafsa is the dictionary as a minimized acyclic automaton over the bytes
+ * of its (case folded) words: a trie whose equal subtrees are stored once, so
+ * words share their prefixes and suffixes. a word is looked up by walking it
+ * byte by byte from the root, so most words that are not in the dictionary
+ * are rejected after their first byte or two, with no hashing at all.
+ *
+ * every edge knows how many words it skips (the words that sort before the
+ * ones it leads to), so the walk also adds up the index of the word among the
+ * sorted words (a minimal perfect hash), which finds its entry without
+ * comparing any strings. built with the algorithm of Daciuk et al. for sorted
+ * input: only the states of the last word's path are unfinished, and a state
+ * is replaced by an equal one already built as soon as it is finished.
+ */
+
+#define NONE  0xFFFFFFFF // no edge (or newspeak offset of badspeak)
+#define LANE  16 // labels compared per SIMD step
+#define FINAL 0x80000000 // bit of a state's header set if a word ends at the state
+
+/* a word of the Dafsa: offsets of its strings in the pool */
+typedef struct Entry {
+    uint32_t oldspeak;
+    uint32_t newspeak; // NONE for badspeak
+} Entry;
+
+/*
+ * Dafsa definition. a state is a block of cells, and is named by where its
+ * block starts, so a step of the walk reads one block (often one cache line):
+ *
+ *   header   the number of edges n, and FINAL
+ *   labels   the n labels in order, 4 per cell
+ *   edges    n pairs of cells: the target state and the rank (words that
+ *            sort before the edge's among its state's)
+ *
+ * the root's edges are also in a table by byte, since every word starts there.
+ */
+struct Dafsa {
+    uint32_t states;
+    uint32_t edges;
+    uint32_t entries; // words
+    uint32_t *cells; // the states (+ LANE / 4 zeros, for the last lane of the last state)
+    uint32_t count; // cells
+    uint32_t root_next[256]; // target of the root's edge for each byte (NONE if none)
+    uint32_t root_rank[256];
+    Entry *table; // entries, in sorted order
+    char *pool; // the NUL terminated oldspeak and newspeak strings
+    size_t pool_bytes;
+};
+
+/* the words being built into a Dafsa (see dafsa_create) */
+typedef struct Builder {
+    /* finished states: first, final and words per state, label, target and rank per edge */
+    uint32_t states;
+    uint32_t state_cap;
+    uint32_t *first;
+    uint8_t *final;
+    uint32_t *words; // words accepted from the state
+    uint32_t edges;
+    uint32_t edge_cap;
+    uint8_t *labels;
+    uint32_t *targets;
+    uint32_t *ranks;
+
+    /* the register: finished states by their edges (state + 1, 0 if the slot is empty) */
+    uint32_t *slots;
+    uint32_t capacity; // a power of 2
+
+    /* the unfinished states of the last word's path. their edges are a stack: state d's are */
+    /* base[d] .. the next state's base, and the last one leads to state d + 1 (if it exists) */
+    uint32_t depth;
+    uint8_t *path_final;
+    uint32_t *base;
+    uint32_t stack;
+    uint32_t stack_cap;
+    uint8_t *stack_labels;
+    uint32_t *stack_targets;
+} Builder;
+
+/* nodes of the HT, collected to be sorted */
+typedef struct Nodes {
+    Node **nodes;
+    uint32_t count;
+    uint32_t size;
+    bool failed;
+} Nodes;
+
+/* helper function for ht_foreach: adds a node to the Nodes array */
+static void collect(Node *n, void *arg) {
+    Nodes *all = (Nodes *) arg;
+
+    if (all->count == all->size) {
+        uint32_t size = all->size ? all->size * 2 : 1024;
+        Node **nodes = (Node **) realloc(all->nodes, size * sizeof(Node *));
+        if (!nodes) {
+            all->failed = true;
+            return;
+        }
+        all->nodes = nodes;
+        all->size = size;
+    }
+
+    all->nodes[all->count++] = n;
+    return;
+}
+
+/* helper function for qsort that orders nodes by their oldspeak bytes */
+static int by_oldspeak(const void *a, const void *b) {
+    return strcmp((*(Node *const *) a)->oldspeak, (*(Node *const *) b)->oldspeak);
+}
+
+/* helper function that resizes an array to hold count items of size bytes. returns false if out of memory */
+static bool reserve(void **array, uint32_t count, size_t size) {
+    void *grown = realloc(*array, (size_t) count * size);
+    if (!grown)
+        return false;
+    *array = grown;
+    return true;
+}
+
+/* helper function that hashes a state by its finality and edges */
+static uint64_t state_hash(bool final, const uint8_t *labels, const uint32_t *targets, uint32_t n) {
+    uint64_t h = final ? 0x9e3779b97f4a7c15 : 0x6a09e667f3bcc909;
+    for (uint32_t i = 0; i < n; i++) {
+        h = (h ^ (((uint64_t) targets[i] << 8) | labels[i])) * 0x100000001b3;
+        h ^= h >> 29;
+    }
+    return h ^ (h >> 32);
+}
+
+/* helper function that checks if finished state s has the given finality and edges */
+static bool state_equal(
+    Builder *b, uint32_t s, bool final, const uint8_t *labels, const uint32_t *targets, uint32_t n) {
+    uint32_t e = b->first[s];
+    return b->final[s] == final && b->first[s + 1] - e == n && !memcmp(b->labels + e, labels, n)
+           && !memcmp(b->targets + e, targets, n * sizeof(uint32_t));
+}
+
+/* helper function that puts finished state s in the register (which has room) */
+static void register_state(Builder *b, uint32_t s) {
+    uint32_t e = b->first[s];
+    uint64_t h = state_hash(b->final[s], b->labels + e, b->targets + e, b->first[s + 1] - e);
+    uint32_t i = (uint32_t) h & (b->capacity - 1);
+    while (b->slots[i])
+        i = (i + 1) & (b->capacity - 1);
+    b->slots[i] = s + 1;
+    return;
+}
+
+/* helper function that doubles the register (when it is half full). returns false if out of memory */
+static bool grow_register(Builder *b) {
+    free(b->slots);
+    b->capacity *= 2;
+    b->slots = (uint32_t *) calloc(b->capacity, sizeof(uint32_t));
+    if (!b->slots)
+        return false;
+    for (uint32_t s = 0; s < b->states; s++)
+        register_state(b, s);
+    return true;
+}
+
+/*
+ * helper function that finishes unfinished state d (the deepest): returns an
+ * equal finished state if there is one, otherwise makes it a finished state.
+ * its edges are popped off the stack either way. returns NONE if out of memory.
+ */
+static uint32_t finish(Builder *b, uint32_t d) {
+    uint32_t from = b->base[d], n = b->stack - from;
+    const uint8_t *labels = b->stack_labels + from;
+    const uint32_t *targets = b->stack_targets + from;
+    bool final = b->path_final[d];
+    b->stack = from;
+
+    uint64_t h = state_hash(final, labels, targets, n);
+    for (uint32_t i = (uint32_t) h & (b->capacity - 1); b->slots[i]; i = (i + 1) & (b->capacity - 1))
+        if (state_equal(b, b->slots[i] - 1, final, labels, targets, n))
+            return b->slots[i] - 1;
+
+    /* a new state: its edges go after the last finished state's */
+    if (2 * (b->states + 1) > b->capacity && !grow_register(b))
+        return NONE;
+    if (b->states + 2 > b->state_cap) {
+        uint32_t cap = b->state_cap * 2;
+        if (!reserve((void **) &(b->first), cap + 1, sizeof(uint32_t))
+            || !reserve((void **) &(b->final), cap, sizeof(uint8_t))
+            || !reserve((void **) &(b->words), cap, sizeof(uint32_t)))
+            return NONE;
+        b->state_cap = cap;
+    }
+    if (b->edges + n > b->edge_cap) {
+        uint32_t cap = b->edge_cap * 2 > b->edges + n ? b->edge_cap * 2 : b->edges + n;
+        if (!reserve((void **) &(b->labels), cap, sizeof(uint8_t))
+            || !reserve((void **) &(b->targets), cap, sizeof(uint32_t))
+            || !reserve((void **) &(b->ranks), cap, sizeof(uint32_t)))
+            return NONE;
+        b->edge_cap = cap;
+    }
+
+    uint32_t s = b->states++, e = b->edges, words = final;
+    memcpy(b->labels + e, labels, n);
+    memcpy(b->targets + e, targets, n * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        b->ranks[e + i] = words;
+        words += b->words[targets[i]];
+    }
+    b->edges += n;
+    b->first[s] = e;
+    b->first[s + 1] = b->edges;
+    b->final[s] = final;
+    b->words[s] = words;
+
+    register_state(b, s);
+    return s;
+}
+
+/* helper function that finishes the unfinished states deeper than depth. returns false if out of memory */
+static bool finish_path(Builder *b, uint32_t depth) {
+    for (; b->depth > depth; b->depth--) {
+        uint32_t s = finish(b, b->depth);
+        if (s == NONE)
+            return false;
+        b->stack_targets[b->stack - 1] = s; // the parent's last edge
+    }
+    return true;
+}
+
+/* helper function that adds a word (greater than the last one) to the unfinished path */
+static bool add_word(Builder *b, const char *word, uint32_t length, uint32_t common) {
+    if (!finish_path(b, common))
+        return false;
+
+    if (b->stack + length - common > b->stack_cap) {
+        uint32_t cap = b->stack_cap * 2 > b->stack + length ? b->stack_cap * 2 : b->stack + length;
+        if (!reserve((void **) &(b->stack_labels), cap, sizeof(uint8_t))
+            || !reserve((void **) &(b->stack_targets), cap, sizeof(uint32_t)))
+            return false;
+        b->stack_cap = cap;
+    }
+
+    for (uint32_t i = common; i < length; i++) {
+        b->stack_labels[b->stack] = (uint8_t) word[i];
+        b->stack_targets[b->stack++] = NONE; // set when the next state is finished
+        b->depth++;
+        b->base[b->depth] = b->stack;
+        b->path_final[b->depth] = 0;
+    }
+    b->path_final[b->depth] = 1;
+    return true;
+}
+
+/* helper function that frees a Builder */
+static void builder_free(Builder *b) {
+    free(b->first);
+    free(b->final);
+    free(b->words);
+    free(b->labels);
+    free(b->targets);
+    free(b->ranks);
+    free(b->slots);
+    free(b->path_final);
+    free(b->base);
+    free(b->stack_labels);
+    free(b->stack_targets);
+    return;
+}
+
+/*
+ * helper function that builds the automaton of the sorted words into a.
+ * returns false if out of memory.
+ */
+static bool build(Dafsa *a, Node **nodes, uint32_t n) {
+    uint32_t longest = 0;
+    for (uint32_t i = 0; i < n; i++)
+        longest = nodes[i]->length > longest ? nodes[i]->length : longest;
+
+    Builder b;
+    memset(&b, 0, sizeof(Builder));
+    b.state_cap = b.edge_cap = b.stack_cap = b.capacity = 1024;
+    b.first = (uint32_t *) malloc((b.state_cap + 1) * sizeof(uint32_t));
+    b.final = (uint8_t *) malloc(b.state_cap * sizeof(uint8_t));
+    b.words = (uint32_t *) malloc(b.state_cap * sizeof(uint32_t));
+    b.labels = (uint8_t *) malloc(b.edge_cap * sizeof(uint8_t));
+    b.targets = (uint32_t *) malloc(b.edge_cap * sizeof(uint32_t));
+    b.ranks = (uint32_t *) malloc(b.edge_cap * sizeof(uint32_t));
+    b.slots = (uint32_t *) calloc(b.capacity, sizeof(uint32_t));
+    b.path_final = (uint8_t *) calloc(longest + 1, sizeof(uint8_t));
+    b.base = (uint32_t *) calloc(longest + 1, sizeof(uint32_t));
+    b.stack_labels = (uint8_t *) malloc(b.stack_cap * sizeof(uint8_t));
+    b.stack_targets = (uint32_t *) malloc(b.stack_cap * sizeof(uint32_t));
+    bool ok = b.first && b.final && b.words && b.labels && b.targets && b.ranks && b.slots
+              && b.path_final && b.base && b.stack_labels && b.stack_targets;
+
+    /* each word only adds the states past its common prefix with the last one */
+    const char *last = "";
+    for (uint32_t i = 0; ok && i < n; i++) {
+        uint32_t common = 0;
+        while (last[common] && last[common] == nodes[i]->oldspeak[common])
+            common++;
+        ok = add_word(&b, nodes[i]->oldspeak, nodes[i]->length, common);
+        last = nodes[i]->oldspeak;
+    }
+
+    uint32_t root = ok && finish_path(&b, 0) ? finish(&b, 0) : NONE;
+    ok = root != NONE;
+
+    /*
+     * where the block of each finished state starts (reusing words, which is
+     * not needed anymore). the blocks are laid out breadth first from the
+     * root, so the states near the root, which most walks end in, are
+     * packed together at the front.
+     */
+    uint32_t *order = ok ? (uint32_t *) malloc(b.states * sizeof(uint32_t)) : NULL;
+    uint64_t count = 0;
+    ok = order != NULL;
+    if (ok) {
+        for (uint32_t st = 0; st < b.states; st++)
+            b.words[st] = NONE;
+        uint32_t head = 0, tail = 0;
+        order[tail++] = root;
+        b.words[root] = 0;
+        while (head < tail) {
+            uint32_t st = order[head++], degree = b.first[st + 1] - b.first[st];
+            b.words[st] = (uint32_t) count;
+            count += 1 + (degree + 3) / 4 + 2 * degree;
+            for (uint32_t e = b.first[st]; e < b.first[st + 1]; e++) {
+                if (b.words[b.targets[e]] == NONE) {
+                    b.words[b.targets[e]] = 0; // queued
+                    order[tail++] = b.targets[e];
+                }
+            }
+        }
+    }
+    free(order);
+    ok = ok && count + LANE / 4 < NONE;
+
+    a->cells = ok ? (uint32_t *) calloc(count + LANE / 4, sizeof(uint32_t)) : NULL;
+    ok = a->cells != NULL;
+
+    for (uint32_t st = 0; ok && st < b.states; st++) {
+        uint32_t e = b.first[st], degree = b.first[st + 1] - e;
+        uint32_t *block = a->cells + b.words[st];
+        block[0] = degree | (b.final[st] ? FINAL : 0);
+        memcpy(block + 1, b.labels + e, degree);
+
+        uint32_t *edges = block + 1 + (degree + 3) / 4;
+        for (uint32_t k = 0; k < degree; k++) {
+            edges[2 * k] = b.words[b.targets[e + k]];
+            edges[2 * k + 1] = b.ranks[e + k];
+        }
+    }
+
+    if (ok) {
+        for (uint32_t c = 0; c < 256; c++)
+            a->root_next[c] = a->root_rank[c] = NONE;
+        for (uint32_t e = b.first[root]; e < b.first[root + 1]; e++) {
+            a->root_next[b.labels[e]] = b.words[b.targets[e]];
+            a->root_rank[b.labels[e]] = b.ranks[e];
+        }
+
+        a->states = b.states;
+        a->edges = b.edges;
+        a->count = (uint32_t) count;
+    }
+
+    builder_free(&b);
+    return ok;
+}
+
+/*
+ * constructor for a Dafsa of the words in ht (which stays as it is). the
+ * words are sorted, so their index in the Dafsa is their rank.
+ */
+Dafsa *dafsa_create(HashTable *ht) {
+    if (!ht)
+        return NULL;
+
+    Dafsa *a = (Dafsa *) calloc(1, sizeof(Dafsa));
+    if (!a)
+        return NULL;
+
+    Nodes all = { NULL, 0, 0, false };
+    ht_foreach(ht, collect, &all);
+    if (all.failed) {
+        free(all.nodes);
+        free(a);
+        return NULL;
+    }
+
+    uint32_t n = all.count;
+    if (n)
+        qsort(all.nodes, n, sizeof(Node *), by_oldspeak);
+
+    /* the entries and their strings, in the same order */
+    for (uint32_t i = 0; i < n; i++) {
+        a->pool_bytes += all.nodes[i]->length + 1;
+        if (all.nodes[i]->newspeak)
+            a->pool_bytes += strlen(all.nodes[i]->newspeak) + 1;
+    }
+
+    a->entries = n;
+    a->table = (Entry *) malloc((n ? n : 1) * sizeof(Entry));
+    a->pool = (char *) malloc(a->pool_bytes ? a->pool_bytes : 1);
+    bool ok = a->table && a->pool && a->pool_bytes < NONE;
+
+    size_t used = 0;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        Node *w = all.nodes[i];
+        a->table[i].oldspeak = (uint32_t) used;
+        memcpy(a->pool + used, w->oldspeak, w->length + 1);
+        used += w->length + 1;
+
+        a->table[i].newspeak = w->newspeak ? (uint32_t) used : NONE;
+        if (w->newspeak) {
+            size_t length = strlen(w->newspeak) + 1;
+            memcpy(a->pool + used, w->newspeak, length);
+            used += length;
+        }
+    }
+
+    ok = ok && build(a, all.nodes, n);
+    free(all.nodes);
+
+    if (!ok)
+        dafsa_delete(&a);
+    return a;
+}
+
+/* destructor for a Dafsa */
+void dafsa_delete(Dafsa **a) {
+    if (a && *a) {
+        free((*a)->cells);
+        free((*a)->table);
+        free((*a)->pool);
+        free(*a);
+        *a = NULL;
+    }
+    return;
+}
+
+/* helper function that lowercases an ASCII letter (the other bytes of a word are folded already) */
+static inline uint8_t lower(char c) {
+    uint8_t u = (uint8_t) c;
+    return (uint8_t) (u + (((uint32_t) (u - 'A') < 26u) << 5));
+}
+
+/* helper function that returns which of the n labels is c (NONE if none is) */
+static inline uint32_t find_label(const uint8_t *labels, uint32_t n, uint8_t c) {
+#ifdef __SSE2__
+    __m128i key = _mm_set1_epi8((char) c);
+    for (uint32_t k = 0; k < n; k += LANE) {
+        __m128i lane = _mm_loadu_si128((const __m128i *) (labels + k));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lane, key));
+        if (mask) {
+            k += (uint32_t) __builtin_ctz(mask);
+            return k < n ? k : NONE; // past n are the state's edges
+        }
+    }
+#else
+    for (uint32_t k = 0; k < n && labels[k] <= c; k++)
+        if (labels[k] == c)
+            return k;
+#endif
+    return NONE;
+}
+
+/*
+ * looks up word (length bytes, case folded except for ASCII letters, which
+ * are lowercased on the way). if found, sets old_out and new_out to its
+ * strings (new_out is NULL for badspeak). the walk is counted in stats (if
+ * not NULL) as a seek, and the edges it took past the first as its links.
+ */
+bool dafsa_lookup(Dafsa *a, const char *word, uint32_t length, const char **old_out,
+    const char **new_out, Stats *stats) {
+    if (!a || !word || !length)
+        return false;
+
+    uint8_t c = lower(word[0]);
+    uint32_t s = a->root_next[c], index = a->root_rank[c], i = 1;
+
+    /* stop at the first byte the state has no edge for */
+    while (s != NONE && i < length) {
+        const uint32_t *block = a->cells + s;
+        uint32_t n = block[0] & ~FINAL;
+        uint32_t k = find_label((const uint8_t *) (block + 1), n, lower(word[i]));
+        if (k == NONE) {
+            s = NONE;
+            break;
+        }
+        const uint32_t *edge = block + 1 + (n + 3) / 4 + 2 * k;
+        s = edge[0];
+        index += edge[1];
+        i++;
+    }
+
+    if (stats) {
+        stats->seeks++;
+        stats->links += i - 1;
+    }
+
+    if (s == NONE || !(a->cells[s] & FINAL))
+        return false;
+
+    *old_out = a->pool + a->table[index].oldspeak;
+    *new_out = a->table[index].newspeak == NONE ? NULL : a->pool + a->table[index].newspeak;
+    return true;
+}
+
+/* returns the number of words in the Dafsa */
+uint32_t dafsa_entries(Dafsa *a) {
+    return a ? a->entries : 0;
+}
+
+/* returns the number of states of the Dafsa */
+uint32_t dafsa_states(Dafsa *a) {
+    return a ? a->states : 0;
+}
+
+/* returns the number of edges of the Dafsa */
+uint32_t dafsa_edges(Dafsa *a) {
+    return a ? a->edges : 0;
+}
+
+/* returns the bytes the Dafsa holds (for stats) */
+size_t dafsa_bytes(Dafsa *a) {
+    if (!a)
+        return 0;
+    return sizeof(Dafsa) + ((size_t) a->count + LANE / 4) * sizeof(uint32_t)
+           + (size_t) a->entries * sizeof(Entry) + a->pool_bytes;
+}
@@ -0,0 +1,28 @@
+#ifndef __DAFSA_H__
+#define __DAFSA_H__
+
+#include "ht.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Dafsa Dafsa;
+
+Dafsa *dafsa_create(HashTable *ht);
+
+void dafsa_delete(Dafsa **a);
+
+bool dafsa_lookup(Dafsa *a, const char *word, uint32_t length, const char **old_out,
+    const char **new_out, Stats *stats);
+
+uint32_t dafsa_entries(Dafsa *a);
+
+uint32_t dafsa_states(Dafsa *a);
+
+uint32_t dafsa_edges(Dafsa *a);
+
+size_t dafsa_bytes(Dafsa *a);
+
+#endif
@@ -0,0 +1,397 @@
+#include "dict.h"
+
+#include "baked.h"
+#include "bf.h"
+#include "dafsa.h"
+#include "hash.h"
+#include "ht.h"
+#include "node.h"
+#include "normalize.h"
+#include "phrases.h"
+#include "snapshot.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOKUP_BATCH 64 // most words looked up in the HT at once
+
+/*
+ * Dict definition. the dictionary the words are filtered against: either
+ * built from the word files (a BF and a HT, or a Dafsa), mapped from a
+ * snapshot, or baked into the binary (see baked.c). all but the Dafsa digest
+ * words with the Hasher the dictionary was made with.
+ */
+struct Dict {
+    Hasher *hasher;
+    uint64_t salt[2]; // salt of the hasher (saved in snapshots)
+    HashBackend backend;
+    BloomFilter *bf; // the BF (the snapshot's when mapped, NULL when baked or an automaton)
+    HashTable *ht; // NULL when mapped, baked or an automaton
+    Dafsa *dafsa; // the automaton (NULL unless built as one)
+    Snapshot *snapshot; // NULL when built or baked
+    const Baked *baked; // NULL when built or mapped
+    Phrases *phrases; // NULL if there are none (see dict_set_phrases)
+    Normalizer *normalizer; // NULL unless obfuscated words are matched (see dict_set_normalizer)
+};
+
+/* constructor for a Dict over a built BF and HT (it owns them from now on) */
+Dict *dict_create(HashTable *ht, BloomFilter *bf, HashBackend backend, uint64_t *salt) {
+    if (!ht || !bf || !salt)
+        return NULL;
+
+    Dict *d = (Dict *) malloc(sizeof(Dict));
+
+    if (d) {
+        d->salt[0] = salt[0];
+        d->salt[1] = salt[1];
+        d->backend = backend;
+        d->bf = bf;
+        d->ht = ht;
+        d->snapshot = NULL;
+        d->baked = NULL;
+        d->dafsa = NULL;
+        d->phrases = NULL;
+        d->normalizer = NULL;
+        d->hasher = hasher_create(backend, salt);
+        if (!d->hasher) {
+            free(d);
+            d = NULL;
+        }
+    }
+
+    return d;
+}
+
+/* constructor for a Dict mapped from the snapshot at path */
+Dict *dict_open(const char *path) {
+    Snapshot *s = snapshot_open(path);
+    if (!s)
+        return NULL;
+
+    Dict *d = (Dict *) malloc(sizeof(Dict));
+
+    if (d) {
+        uint64_t *salt = snapshot_salt(s);
+        d->salt[0] = salt[0];
+        d->salt[1] = salt[1];
+        d->backend = snapshot_backend(s);
+        d->bf = snapshot_bf(s);
+        d->ht = NULL;
+        d->snapshot = s;
+        d->baked = NULL;
+        d->dafsa = NULL;
+        d->phrases = NULL;
+        d->normalizer = NULL;
+        d->hasher = hasher_create(d->backend, d->salt); // digests must match the saved ones
+        if (!d->hasher) {
+            free(d);
+            d = NULL;
+        }
+    }
+
+    if (!d)
+        snapshot_close(&s);
+
+    return d;
+}
+
+/*
+ * constructor for a Dict over a Dafsa of the words in ht, which is deleted
+ * once they are in the automaton (so words cannot be added or removed).
+ */
+Dict *dict_automaton(HashTable *ht, HashBackend backend, uint64_t *salt) {
+    if (!ht || !salt)
+        return NULL;
+
+    Dafsa *a = dafsa_create(ht);
+    Dict *d = a ? (Dict *) malloc(sizeof(Dict)) : NULL;
+
+    if (d) {
+        d->salt[0] = salt[0];
+        d->salt[1] = salt[1];
+        d->backend = backend;
+        d->bf = NULL;
+        d->ht = NULL;
+        d->snapshot = NULL;
+        d->baked = NULL;
+        d->dafsa = a;
+        d->phrases = NULL;
+        d->normalizer = NULL;
+        d->hasher = hasher_create(backend, salt); // only for dict_digest, the walk does not hash
+        if (!d->hasher) {
+            free(d);
+            d = NULL;
+        }
+    }
+
+    if (!d) {
+        dafsa_delete(&a);
+        return NULL;
+    }
+
+    ht_delete(&ht);
+    return d;
+}
+
+/* constructor for a Dict over baked tables (they are static, the Dict does not own them) */
+Dict *dict_static(const Baked *b) {
+    if (!b)
+        return NULL;
+
+    Dict *d = (Dict *) malloc(sizeof(Dict));
+
+    if (d) {
+        d->salt[0] = b->salt[0];
+        d->salt[1] = b->salt[1];
+        d->backend = b->backend;
+        d->bf = NULL;
+        d->ht = NULL;
+        d->snapshot = NULL;
+        d->baked = b;
+        d->dafsa = NULL;
+        d->phrases = NULL;
+        d->normalizer = NULL;
+        d->hasher = hasher_create(d->backend, d->salt); // digests must match the baked ones
+        if (!d->hasher) {
+            free(d);
+            d = NULL;
+        }
+    }
+
+    return d;
+}
+
+/* destructor for a Dict */
+void dict_delete(Dict **d) {
+    if (d && *d) {
+        hasher_delete(&((*d)->hasher));
+        phrases_delete(&((*d)->phrases));
+        normalizer_delete(&((*d)->normalizer));
+        if ((*d)->snapshot)
+            snapshot_close(&((*d)->snapshot)); // the BF belongs to the snapshot
+        else if (!(*d)->baked) {
+            dafsa_delete(&((*d)->dafsa));
+            ht_delete(&((*d)->ht));
+            bf_delete(&((*d)->bf));
+        }
+        free(*d);
+        *d = NULL;
+    }
+    return;
+}
+
+/* saves a built Dict as a snapshot at path */
+bool dict_save(Dict *d, const char *path) {
+    if (!d || !d->ht)
+        return false; // mapped dicts are snapshots already
+    return snapshot_write(path, d->bf, d->ht, d->backend, d->salt);
+}
+
+/* writes a built Dict as C source at path (see baked_write) */
+bool dict_bake(Dict *d, const char *path) {
+    if (!d || !d->ht)
+        return false;
+    return baked_write(path, d->ht, d->backend, d->salt);
+}
+
+/*
+ * gives the Dict phrases to match besides its words (it owns them from now
+ * on, and deletes them right away if there are none). they must be built.
+ */
+void dict_set_phrases(Dict *d, Phrases *p) {
+    if (!d) {
+        phrases_delete(&p);
+        return;
+    }
+
+    phrases_delete(&(d->phrases));
+    if (!phrases_count(p))
+        phrases_delete(&p);
+    d->phrases = p;
+    return;
+}
+
+/*
+ * gives the Dict a Normalizer whose index holds its words, so the words of
+ * the input are also matched by their canonical form (it owns it from now on).
+ */
+void dict_set_normalizer(Dict *d, Normalizer *z) {
+    if (!d) {
+        normalizer_delete(&z);
+        return;
+    }
+
+    normalizer_delete(&(d->normalizer));
+    d->normalizer = z;
+    return;
+}
+
+/* returns the digest of a word (length bytes) */
+Digest dict_digest(Dict *d, const char *word, uint32_t length) {
+    return hasher_digest(d->hasher, word, length);
+}
+
+/* checks if the word with digest dg may be in the Dict (its BF, or the fingerprint of its baked slot) */
+/* (an automaton has no filter: every word may be in it) */
+bool dict_probe(Dict *d, Digest *dg) {
+    if (d && d->dafsa)
+        return true;
+    if (d && d->baked)
+        return baked_probe(d->baked, dg);
+    return d && bf_probe(d->bf, dg);
+}
+
+/* looks up word (length bytes, digest dg). fills m and returns true if found (counted in stats) */
+bool dict_lookup(Dict *d, Digest *dg, char *word, uint32_t length, Match *m, Stats *stats) {
+    if (!d || !m)
+        return false;
+
+    if (d->snapshot)
+        return snapshot_lookup(
+            d->snapshot, dg, word, length, &(m->oldspeak), &(m->newspeak), stats);
+    if (d->baked)
+        return baked_lookup(d->baked, dg, word, length, &(m->oldspeak), &(m->newspeak), stats);
+    if (d->dafsa)
+        return dafsa_lookup(d->dafsa, word, length, &(m->oldspeak), &(m->newspeak), stats);
+
+    Node *n = ht_lookup(d->ht, dg, word, length, stats);
+    if (!n)
+        return false;
+
+    m->oldspeak = n->oldspeak;
+    m->newspeak = n->newspeak;
+    return true;
+}
+
+/*
+ * adds oldspeak (badspeak if newspeak is NULL) to a built Dict. returns false
+ * if it is in the Dict already (its translation is not replaced) or the Dict
+ * is mapped. the BF is only touched when the HT took the word, so adding a
+ * word twice counts it once in a counting BF.
+ */
+bool dict_add(Dict *d, char *oldspeak, char *newspeak) {
+    if (!d || !d->ht || !oldspeak)
+        return false;
+
+    uint32_t length = (uint32_t) strlen(oldspeak), entries = ht_entries(d->ht);
+    Digest dg = dict_digest(d, oldspeak, length);
+
+    ht_insert(d->ht, &dg, oldspeak, newspeak);
+    if (ht_entries(d->ht) == entries)
+        return false; // already there (or out of memory)
+
+    bf_insert(d->bf, &dg);
+    normalizer_add(d->normalizer, oldspeak, length); // a removed word is only dropped by its lookup
+    return true;
+}
+
+/*
+ * removes oldspeak from a built Dict. returns false if it is not in the Dict
+ * or the Dict is mapped. the word stays in the BF (a false positive) unless
+ * the BF is counting.
+ */
+bool dict_remove(Dict *d, const char *oldspeak) {
+    if (!d || !d->ht || !oldspeak)
+        return false;
+
+    uint32_t length = (uint32_t) strlen(oldspeak);
+    Digest dg = dict_digest(d, oldspeak, length);
+
+    if (!ht_remove(d->ht, &dg, oldspeak, length))
+        return false;
+
+    bf_remove(d->bf, &dg);
+    return true;
+}
+
+/* checks n words at once (see bf_probe_batch) */
+void dict_probe_batch(Dict *d, Digest *dg, uint32_t n, bool *hits) {
+    if (d && d->baked) {
+        for (uint32_t i = 0; i < n; i++)
+            baked_prefetch(d->baked, &dg[i]);
+        for (uint32_t i = 0; i < n; i++)
+            hits[i] = baked_probe(d->baked, &dg[i]);
+    } else if (d && d->dafsa)
+        memset(hits, true, n * sizeof(bool));
+    else if (d)
+        bf_probe_batch(d->bf, dg, n, hits);
+    return;
+}
+
+/*
+ * looks up n words at once, setting found[i] and m[i] like dict_lookup. where
+ * each word would be is prefetched first so the cache misses overlap.
+ */
+void dict_lookup_batch(Dict *d, Digest *dg, char **words, uint32_t *lengths, uint32_t n, Match *m,
+    bool *found, Stats *stats) {
+    if (!d)
+        return;
+
+    if (d->snapshot) {
+        for (uint32_t i = 0; i < n; i++)
+            snapshot_prefetch(d->snapshot, &dg[i]);
+        for (uint32_t i = 0; i < n; i++)
+            found[i] = dict_lookup(d, &dg[i], words[i], lengths[i], &m[i], stats);
+        return;
+    }
+
+    if (d->baked || d->dafsa) { // the probe loaded the baked slots already
+        for (uint32_t i = 0; i < n; i++)
+            found[i] = dict_lookup(d, &dg[i], words[i], lengths[i], &m[i], stats);
+        return;
+    }
+
+    /* through the HT's batch lookup, LOOKUP_BATCH words at a time */
+    Node *nodes[LOOKUP_BATCH];
+    for (uint32_t i = 0; i < n; i += LOOKUP_BATCH) {
+        uint32_t count = n - i < LOOKUP_BATCH ? n - i : LOOKUP_BATCH;
+        ht_lookup_batch(d->ht, dg + i, words + i, lengths + i, count, nodes, stats);
+
+        for (uint32_t j = 0; j < count; j++) {
+            found[i + j] = nodes[j] != NULL;
+            if (nodes[j]) {
+                m[i + j].oldspeak = nodes[j]->oldspeak;
+                m[i + j].newspeak = nodes[j]->newspeak;
+            }
+        }
+    }
+
+    return;
+}
+
+/* returns the BF of the Dict (NULL if baked or an automaton) */
+BloomFilter *dict_bf(Dict *d) {
+    return d ? d->bf : NULL;
+}
+
+/* returns the HT of the Dict (NULL if mapped from a snapshot, baked or an automaton) */
+HashTable *dict_ht(Dict *d) {
+    return d ? d->ht : NULL;
+}
+
+/* returns the snapshot the Dict is mapped from (NULL if built) */
+Snapshot *dict_snapshot(Dict *d) {
+    return d ? d->snapshot : NULL;
+}
+
+/* returns the baked tables of the Dict (NULL if built or mapped) */
+const Baked *dict_baked(Dict *d) {
+    return d ? d->baked : NULL;
+}
+
+/* returns the automaton of the Dict (NULL if not built as one) */
+Dafsa *dict_dafsa(Dict *d) {
+    return d ? d->dafsa : NULL;
+}
+
+/* returns the phrases of the Dict (NULL if it has none) */
+Phrases *dict_phrases(Dict *d) {
+    return d ? d->phrases : NULL;
+}
+
+/* returns the Normalizer of the Dict (NULL if obfuscated words are not matched) */
+Normalizer *dict_normalizer(Dict *d) {
+    return d ? d->normalizer : NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef __DICT_H__
+#define __DICT_H__
+
+#include "baked.h"
+#include "bf.h"
+#include "dafsa.h"
+#include "hash.h"
+#include "ht.h"
+#include "normalize.h"
+#include "phrases.h"
+#include "snapshot.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Dict Dict;
+
+/* a word found in the dictionary (newspeak is NULL for badspeak) */
+typedef struct Match {
+    const char *oldspeak;
+    const char *newspeak;
+} Match;
+
+Dict *dict_create(HashTable *ht, BloomFilter *bf, HashBackend backend, uint64_t *salt);
+
+Dict *dict_open(const char *path);
+
+Dict *dict_automaton(HashTable *ht, HashBackend backend, uint64_t *salt);
+
+Dict *dict_static(const Baked *b);
+
+void dict_delete(Dict **d);
+
+bool dict_save(Dict *d, const char *path);
+
+bool dict_bake(Dict *d, const char *path);
+
+void dict_set_phrases(Dict *d, Phrases *p);
+
+void dict_set_normalizer(Dict *d, Normalizer *z);
+
+Digest dict_digest(Dict *d, const char *word, uint32_t length);
+
+bool dict_probe(Dict *d, Digest *dg);
+
+bool dict_lookup(Dict *d, Digest *dg, char *word, uint32_t length, Match *m, Stats *stats);
+
+bool dict_add(Dict *d, char *oldspeak, char *newspeak);
+
+bool dict_remove(Dict *d, const char *oldspeak);
+
+void dict_probe_batch(Dict *d, Digest *dg, uint32_t n, bool *hits);
+
+void dict_lookup_batch(Dict *d, Digest *dg, char **words, uint32_t *lengths, uint32_t n, Match *m,
+    bool *found, Stats *stats);
+
+BloomFilter *dict_bf(Dict *d);
+
+HashTable *dict_ht(Dict *d);
+
+Snapshot *dict_snapshot(Dict *d);
+
+const Baked *dict_baked(Dict *d);
+
+Dafsa *dict_dafsa(Dict *d);
+
+Phrases *dict_phrases(Dict *d);
+
+Normalizer *dict_normalizer(Dict *d);
+
+#endif
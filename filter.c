@@ -0,0 +1,562 @@
+#include "filter.h"
+
+#include "collector.h"
+#include "dafsa.h"
+#include "dict.h"
+#include "normalize.h"
+#include "parser.h"
+#include "phrases.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH       32 // words hashed, probed and looked up together
+#define BATCH_BYTES (4 * MAX_WORD) // room for the folded words of a batch
+#define PRIME_BYTES 256 // bytes before a text first looked through for its phrases (see filter_prime)
+#define SPAN_WORDS  16 // most words joined into one obfuscated word (see filter_span)
+
+/*
+ * words of the input filtered together (see filter_batch): all are hashed,
+ * then all are probed, then the ones that passed are all looked up, so the
+ * cache misses of each step overlap instead of stalling word by word.
+ */
+typedef struct Batch {
+    uint32_t count; // words in the batch
+    uint32_t used; // bytes of text used
+    char text[BATCH_BYTES]; // folded copies of the words
+    char *words[BATCH];
+    uint32_t lengths[BATCH];
+    Digest digests[BATCH];
+    bool passed[BATCH]; // passed the bf
+    bool found[BATCH]; // in the dictionary
+    Match matches[BATCH];
+    uint32_t at[BATCH]; // where each word that passed the bf was in the batch
+    uint32_t states[BATCH]; // the tokens of the words, then where phrases end after them (see phrases_next)
+    bool canonical[BATCH]; // found by its canonical form (see filter_canonical)
+    Match canon[BATCH];
+} Batch;
+
+/*
+ * Filter definition. everything that changes while text is filtered against
+ * a dictionary: the transgressions found, the counters and the batch. the
+ * dictionary is only read, so any number of Filters (e.g. one per thread)
+ * can share one without locking.
+ */
+struct Filter {
+    Dict *dict; // shared, only read
+    Collector *bad_buf; // badspeak words used
+    Collector *right_buf; // oldspeak words used and their newspeak
+    Stats stats;
+    bool timed; // time the stages into stats (see filter_time)
+    uint32_t phrase; // state of the dictionary's phrases after the words so far
+    const char *span; // end of the last obfuscated word found in the text (see filter_canonical)
+    char spelled[WORDS_FOLDED(MAX_WORD)]; // an obfuscated word of several words, case folded
+    char form[WORDS_FOLDED(MAX_WORD)]; // its canonical form
+    Batch batch;
+};
+
+/* constructor for a Filter of text against dict */
+Filter *filter_create(Dict *dict) {
+    if (!dict)
+        return NULL;
+
+    Filter *f = (Filter *) malloc(sizeof(Filter));
+
+    if (f) {
+        f->dict = dict;
+        f->bad_buf = collector_create();
+        f->right_buf = collector_create();
+        memset(&(f->stats), 0, sizeof(Stats));
+        f->timed = false;
+        f->phrase = PHRASES_START;
+        f->span = NULL;
+        f->batch.count = f->batch.used = 0;
+
+        if (!f->bad_buf || !f->right_buf)
+            filter_delete(&f);
+    }
+
+    return f;
+}
+
+/* destructor for a Filter */
+void filter_delete(Filter **f) {
+    if (f && *f) {
+        collector_delete(&((*f)->bad_buf));
+        collector_delete(&((*f)->right_buf));
+        free(*f);
+        *f = NULL;
+    }
+    return;
+}
+
+/*
+ * filters the next texts against dict instead (e.g. a reloaded version, see
+ * live.h). the transgressions point into the dictionary they were found in,
+ * so they must have been reset before switching to another one. a phrase in
+ * progress is dropped when the dictionary changes.
+ */
+void filter_use(Filter *f, Dict *dict) {
+    if (f && dict) {
+        if (dict != f->dict)
+            f->phrase = PHRASES_START;
+        f->dict = dict;
+    }
+    return;
+}
+
+/* times scanning words and looking them up into the counters (costs two clock reads per batch) */
+void filter_time(Filter *f, bool timed) {
+    if (f)
+        f->timed = timed;
+    return;
+}
+
+/* helper function that adds the phrases that end at state (of p, see phrases_next) to the transgressions. returns false if out of memory */
+static bool filter_ends(Filter *f, Phrases *p, uint32_t state) {
+    Match m;
+
+    /* no newspeak translation: thoughtcrime. else rightcrime */
+    while (phrases_output(p, &state, &(m.oldspeak), &(m.newspeak)))
+        if (!collector_add(m.newspeak ? f->right_buf : f->bad_buf, &m))
+            return false;
+    return true;
+}
+
+/* helper function that lowercases an ASCII letter (walked words are not folded) */
+static inline uint8_t lower(char c) {
+    uint8_t u = (uint8_t) c;
+    return (uint8_t) (u + (((uint32_t) (u - 'A') < 26u) << 5));
+}
+
+/*
+ * helper function that finds the obfuscated word the word at view (length
+ * bytes, in text of size bytes) starts: with the punctuation z maps right
+ * before it, and the words after it joined by such punctuation (b.a.d, sh!t)
+ * with the punctuation after the last one (a$$). it spans at most SPAN_WORDS
+ * words and fewer than MAX_WORD bytes, and the punctuation dropped at either
+ * end is left out. returns where it starts, sets end_out and last_out (where
+ * its last word ends).
+ */
+static const char *filter_span(Normalizer *z, const char *text, uint64_t size, const char *view,
+    uint32_t length, const char **end_out, const char **last_out) {
+    const char *start = view, *end = view + length, *stop = text + size;
+
+    while (start > text && end - start + 1 < MAX_WORD && normalizer_inner(z, start[-1]))
+        start--;
+
+    for (uint32_t words = 1;; words++) {
+        *last_out = end;
+
+        const char *e = end;
+        while (e < stop && e - start + 1 < MAX_WORD && normalizer_inner(z, *e))
+            e++;
+        if (e == end)
+            break;
+        end = e;
+
+        /* a word has to start right after the punctuation */
+        if (words == SPAN_WORDS || e == stop || (uint8_t) *e <= ' ')
+            break;
+
+        Words w;
+        uint32_t next;
+        words_init(&w, e, (uint64_t) (stop - e));
+        if (words_next(&w, &next) != e || e + next - start >= MAX_WORD)
+            break;
+        end = e + next;
+    }
+
+    /* the punctuation dropped around it is not part of it (bad. is bad) */
+    while (start < view && normalizer_drops(z, *start))
+        start++;
+    while (end > *last_out && normalizer_drops(z, end[-1]))
+        end--;
+
+    *end_out = end;
+    return start;
+}
+
+/*
+ * helper function that looks the text from start to end up by its canonical
+ * form (see normalize.c), unless it is the word (folded, folded bytes) it
+ * starts with. the dictionary word with that form is looked up again, so the
+ * match is the same as if the word were spelled right (and a word removed
+ * since it was indexed is not found). fills m and returns true if found.
+ */
+static bool filter_form(Filter *f, Normalizer *z, const char *start, const char *end,
+    const char *view, uint32_t length, const char *word, uint32_t folded, Match *m) {
+    const char *spelled = word;
+    uint32_t spelled_length = folded;
+
+    /* a word spelled plainly is not obfuscated (good is not god): its own lookup is enough */
+    if (start == view && end == view + length) {
+        if (normalizer_plain(z, word, folded))
+            return false;
+    } else {
+        spelled_length = words_fold(f->spelled, start, (uint32_t) (end - start));
+        spelled = f->spelled;
+    }
+
+    /* (nor is one whose form is the word itself, with the punctuation around it) */
+    uint32_t n = normalizer_apply(z, f->form, spelled, spelled_length), k = 0;
+    if (n == folded)
+        while (k < n && (uint8_t) f->form[k] == lower(word[k]))
+            k++;
+    if (n == folded && k == n)
+        return false;
+
+    /* nor are numbers obfuscated words (3 is not eee): digits are letters only next to letters */
+    bool letters = false, digits = false;
+    for (uint32_t i = 0; i < spelled_length && !letters; i++) {
+        uint8_t c = lower(spelled[i]);
+        letters = (c >= 'a' && c <= 'z') || c >= 0x80;
+        digits = digits || (c >= '0' && c <= '9');
+    }
+    if (digits && !letters)
+        return false;
+
+    uint32_t known;
+    const char *oldspeak = normalizer_lookup(z, f->form, n, spelled, spelled_length, &known);
+    if (!oldspeak)
+        return false;
+
+    Digest dg = dict_digest(f->dict, oldspeak, known);
+    return dict_lookup(f->dict, &dg, (char *) oldspeak, known, m, NULL);
+}
+
+/*
+ * helper function that looks the word at view (length bytes, in text of size
+ * bytes, folded into word of folded bytes) up by the canonical form of the
+ * obfuscated word it starts (see filter_span): with the punctuation after it
+ * (a$$), else without (b.a.d!). the words after it in the obfuscated word
+ * are not looked up by their own if it is found. fills m and returns true if
+ * found.
+ */
+static bool filter_canonical(Filter *f, Normalizer *z, const char *text, uint64_t size,
+    const char *view, uint32_t length, const char *word, uint32_t folded, Match *m) {
+    if (f->span && view < f->span)
+        return false; // part of the last one found
+
+    const char *end, *last, *start = filter_span(z, text, size, view, length, &end, &last);
+
+    if (filter_form(f, z, start, end, view, length, word, folded, m))
+        f->span = end;
+    else if (last != end && filter_form(f, z, start, last, view, length, word, folded, m))
+        f->span = last;
+    else
+        return false;
+    return true;
+}
+
+/* helper function that filters the words of the batch and empties it. returns false if out of memory */
+static bool filter_batch(Filter *f) {
+    Batch *b = &(f->batch);
+    Stats *s = &(f->stats);
+    Phrases *p = dict_phrases(f->dict);
+    bool every = p || dict_normalizer(f->dict); // words that did not pass the bf may have more to add
+    uint32_t count = b->count;
+
+    /* the phrases go through the words in order, before the ones not in the bf are dropped */
+    /* (all their tokens are looked up first, so the cache misses overlap) */
+    if (p) {
+        for (uint32_t i = 0; i < count; i++)
+            b->states[i] = phrases_token(p, b->words[i], b->lengths[i]);
+        for (uint32_t i = 0; i < count; i++)
+            b->states[i] = phrases_next(p, &(f->phrase), b->states[i]);
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        b->digests[i] = dict_digest(f->dict, b->words[i], b->lengths[i]); // the only hash of a word
+
+    /* skip the words that are not in the bf */
+    dict_probe_batch(f->dict, b->digests, count, b->passed);
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (b->passed[i]) {
+            b->words[n] = b->words[i];
+            b->lengths[n] = b->lengths[i];
+            b->digests[n] = b->digests[i];
+            b->at[n++] = i;
+        }
+    }
+
+    s->probes += count;
+    s->passes += n;
+    b->count = b->used = 0;
+
+    /* and the ones not in the ht either (bf false positives) */
+    dict_lookup_batch(f->dict, b->digests, b->words, b->lengths, n, b->matches, b->found, s);
+
+    /* in the order of the text: a word (or the word its canonical form is), then the phrases it ends */
+    for (uint32_t i = 0, k = 0; k < n || (every && i < count); i++) {
+        bool found = false;
+
+        if (k < n && b->at[k] == i) {
+            found = b->found[k];
+            if (!found)
+                s->false_positives++;
+
+            /* no newspeak translation: thoughtcrime. else rightcrime */
+            else if (!collector_add(b->matches[k].newspeak ? f->right_buf : f->bad_buf,
+                         &(b->matches[k])))
+                return false;
+            k++;
+        }
+
+        /* an obfuscated spelling counts only if the word itself is not in the dictionary */
+        if (!found && b->canonical[i]) {
+            s->normalized++;
+            if (!collector_add(b->canon[i].newspeak ? f->right_buf : f->bad_buf, &(b->canon[i])))
+                return false;
+        }
+
+        if (p && b->states[i] != PHRASES_START && !filter_ends(f, p, b->states[i]))
+            return false;
+    }
+
+    return true;
+}
+
+/* helper function for filter_batch that adds the time it took to the counters if timed */
+static bool filter_flush(Filter *f) {
+    if (!f->timed)
+        return filter_batch(f);
+
+    uint64_t start = stats_clock(CLOCK_MONOTONIC);
+    bool ok = filter_batch(f);
+    f->stats.probe_ns += stats_clock(CLOCK_MONOTONIC) - start;
+    return ok;
+}
+
+/*
+ * helper function for filter_text over an automaton: each word is walked
+ * through it as soon as it is scanned, with no batching, hashing or probing.
+ * ASCII words are walked straight from the input (the walk lowercases them),
+ * the others are case folded into the batch's text first.
+ */
+static bool filter_walk(Filter *f, Dafsa *a, const char *text, uint64_t size) {
+    uint64_t start = f->timed ? stats_clock(CLOCK_MONOTONIC) : 0;
+    Phrases *p = dict_phrases(f->dict);
+    Normalizer *z = dict_normalizer(f->dict);
+    const char *view, *word;
+    uint32_t length, folded;
+    Match m;
+
+    Words w;
+    words_init(&w, text, size);
+
+    while ((view = words_next(&w, &length)) != NULL) {
+        f->stats.words++;
+
+        if (length >= MAX_WORD) {
+            f->phrase = PHRASES_START; // no phrase has the word
+            continue;
+        }
+
+        word = view;
+        folded = length;
+        if (!words_ascii(view, length)) {
+            folded = words_fold(f->batch.text, view, length);
+            word = f->batch.text;
+        }
+
+        /* no newspeak translation: thoughtcrime. else rightcrime */
+        /* (an obfuscated spelling counts only if the word itself is not in the dictionary) */
+        bool found = dafsa_lookup(a, word, folded, &(m.oldspeak), &(m.newspeak), &(f->stats));
+        if (!found && z && filter_canonical(f, z, text, size, view, length, word, folded, &m)) {
+            f->stats.normalized++;
+            found = true;
+        }
+        if (found && !collector_add(m.newspeak ? f->right_buf : f->bad_buf, &m))
+            return false;
+
+        uint32_t end = p ? phrases_next(p, &(f->phrase), phrases_token(p, word, folded)) : 0;
+        if (end != PHRASES_START && !filter_ends(f, p, end))
+            return false;
+    }
+
+    if (f->timed)
+        f->stats.tokenize_ns += stats_clock(CLOCK_MONOTONIC) - start; // walking is tokenizing
+    return true;
+}
+
+/*
+ * filters the words of text (size bytes, WORDS_PADDING readable past them) in
+ * batches, adding the dictionary words found to the transgressions. text must
+ * end between words (see words_split). returns false if out of memory.
+ */
+bool filter_text(Filter *f, const char *text, uint64_t size) {
+    if (!f || !text)
+        return false;
+
+    f->span = NULL; // no obfuscated word found in this text yet
+    Dafsa *a = dict_dafsa(f->dict);
+    if (a)
+        return filter_walk(f, a, text, size);
+
+    Batch *b = &(f->batch);
+    Normalizer *z = dict_normalizer(f->dict);
+    const char *view;
+    uint32_t length;
+
+    /* the time not spent in filter_flush is spent scanning */
+    uint64_t start = f->timed ? stats_clock(CLOCK_MONOTONIC) : 0;
+    uint64_t probing = f->stats.probe_ns;
+
+    Words w;
+    words_init(&w, text, size);
+
+    while ((view = words_next(&w, &length)) != NULL) {
+        f->stats.words++;
+
+        /* dictionary words are shorter than MAX_WORD, so longer ones cannot match */
+        /* (but they end the phrases in progress, after the words before them) */
+        if (length >= MAX_WORD) {
+            if (dict_phrases(f->dict) && b->count && !filter_flush(f))
+                return false;
+            f->phrase = PHRASES_START;
+            continue;
+        }
+
+        if ((b->count == BATCH || b->used + WORDS_FOLDED(length) > BATCH_BYTES) && !filter_flush(f))
+            return false;
+
+        /* the input is only read, so the word is case folded into the batch */
+        char *word = b->text + b->used;
+        uint32_t folded = words_fold(word, view, length);
+        word[folded] = '\0';
+
+        /* its canonical form is looked up now, while the text around it is at hand */
+        b->canonical[b->count]
+            = z && filter_canonical(f, z, text, size, view, length, word, folded, &(b->canon[b->count]));
+        b->words[b->count] = word;
+        b->lengths[b->count++] = folded;
+        b->used += folded + 1;
+    }
+
+    bool ok = filter_flush(f);
+    if (f->timed)
+        f->stats.tokenize_ns
+            += stats_clock(CLOCK_MONOTONIC) - start - (f->stats.probe_ns - probing);
+    return ok;
+}
+
+/*
+ * looks through the words at the end of before (size bytes, the text right
+ * before the next one f filters, filtered by another Filter) for the phrases
+ * that start there, so the ones that end in the next text are found. only
+ * as many words are read as the longest phrase has (but one). if before has
+ * fewer, the phrase in progress (e.g. from filter_follow) goes on through them.
+ */
+void filter_prime(Filter *f, const char *before, uint64_t size) {
+    Phrases *p = f ? dict_phrases(f->dict) : NULL;
+    if (!p || !before)
+        return;
+
+    uint32_t needed = phrases_longest(p) - 1, length;
+    uint64_t from = 0;
+    const char *view;
+    Words w;
+
+    /* from the end of before, further back until the window holds enough words */
+    for (uint64_t window = PRIME_BYTES; window < size; window *= 2) {
+        from = words_split(before, size - window, NULL); // (only the phrases are primed)
+
+        uint32_t words = 0;
+        words_init(&w, before + from, size - from);
+        while (words < needed && words_next(&w, &length))
+            words++;
+        if (!from || words == needed)
+            break;
+        from = 0;
+    }
+
+    if (from)
+        f->phrase = PHRASES_START; // the words before the window are too far back to matter
+
+    words_init(&w, before + from, size - from);
+    while ((view = words_next(&w, &length)) != NULL) {
+        if (length >= MAX_WORD) {
+            f->phrase = PHRASES_START;
+            continue;
+        }
+
+        if (!words_ascii(view, length)) {
+            length = words_fold(f->batch.text, view, length); // the batch is empty between texts
+            view = f->batch.text;
+        }
+        phrases_next(p, &(f->phrase), phrases_token(p, view, length));
+    }
+
+    return;
+}
+
+/* continues the phrases in progress at the end of the text before filtered into the next text f filters */
+void filter_follow(Filter *f, Filter *before) {
+    if (f && before)
+        f->phrase = before->phrase;
+    return;
+}
+
+/*
+ * adds the transgressions and counters of from to to. the transgressions of
+ * from come after to's, like the text from filtered after to's (so to's
+ * phrases in progress are from's now). returns false if out of memory.
+ */
+bool filter_merge(Filter *to, Filter *from) {
+    if (!to || !from)
+        return false;
+
+    to->phrase = from->phrase;
+    stats_add(&(to->stats), &(from->stats));
+    return collector_merge(to->bad_buf, from->bad_buf)
+           && collector_merge(to->right_buf, from->right_buf);
+}
+
+/* forgets the transgressions and counters, to filter the rest of the text (phrases go on into it) */
+void filter_clear(Filter *f) {
+    if (!f)
+        return;
+
+    collector_clear(f->bad_buf);
+    collector_clear(f->right_buf);
+    memset(&(f->stats), 0, sizeof(Stats));
+    return;
+}
+
+/* forgets the transgressions, counters and phrases in progress, to filter another text */
+void filter_reset(Filter *f) {
+    if (!f)
+        return;
+
+    filter_clear(f);
+    f->phrase = PHRASES_START;
+    return;
+}
+
+/* returns the badspeak words found (thoughtcrime) */
+Collector *filter_badspeak(Filter *f) {
+    return f ? f->bad_buf : NULL;
+}
+
+/* returns the oldspeak words found and their newspeak (rightcrime) */
+Collector *filter_rightspeak(Filter *f) {
+    return f ? f->right_buf : NULL;
+}
+
+/* returns the counters */
+Stats *filter_stats(Filter *f) {
+    return f ? &(f->stats) : NULL;
+}
+
+/* returns the bytes the Filter holds (its batch and transgressions, for stats) */
+size_t filter_bytes(Filter *f) {
+    if (!f)
+        return 0;
+    return sizeof(Filter) + collector_bytes(f->bad_buf) + collector_bytes(f->right_buf);
+}
@@ -0,0 +1,45 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include "collector.h"
+#include "dict.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* max size of a word from badspeak and newspeak file words (see design) */
+#define MAX_WORD 4096 // max word size is 4096 (newspeak and badspeak words are capped at 28)
+
+typedef struct Filter Filter;
+
+Filter *filter_create(Dict *dict);
+
+void filter_delete(Filter **f);
+
+void filter_use(Filter *f, Dict *dict);
+
+void filter_time(Filter *f, bool timed);
+
+bool filter_text(Filter *f, const char *text, uint64_t size);
+
+void filter_prime(Filter *f, const char *before, uint64_t size);
+
+void filter_follow(Filter *f, Filter *before);
+
+bool filter_merge(Filter *to, Filter *from);
+
+void filter_clear(Filter *f);
+
+void filter_reset(Filter *f);
+
+Collector *filter_badspeak(Filter *f);
+
+Collector *filter_rightspeak(Filter *f);
+
+Stats *filter_stats(Filter *f);
+
+size_t filter_bytes(Filter *f);
+
+#endif
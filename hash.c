@@ -0,0 +1,161 @@
+#include "hash.h"
+
+#include "speck.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* secrets for the multiply-mix backend (odd constants from wyhash) */
+static const uint64_t wy_secret[4] = {
+    0xa0761d6478bd642f, 0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3, 0x589965cc75374cc3
+};
+
+/* names accepted by backend_parse, indexed by HashBackend */
+static const char *names[NUM_BACKENDS] = { "speck", "wyhash" };
+
+/* Hasher definition */
+struct Hasher {
+    HashBackend backend; // which function computes the digests
+    uint64_t seed; // salt folded into 64 bits (wyhash)
+    uint64_t rk[SPECK_ROUNDS]; // round keys expanded once from the salt (speck)
+};
+
+/* constructor for a Hasher keyed with the 128 bit salt */
+Hasher *hasher_create(HashBackend backend, uint64_t *salt) {
+    if (backend >= NUM_BACKENDS || !salt)
+        return NULL;
+
+    Hasher *h = (Hasher *) malloc(sizeof(Hasher));
+
+    if (h) {
+        h->backend = backend;
+        h->seed = salt[0] ^ salt[1];
+        speck_expand_key(salt, h->rk); // the key schedule never changes after this
+    }
+
+    return h;
+}
+
+/* destructor for a Hasher */
+void hasher_delete(Hasher **h) {
+    if (h && *h) {
+        free(*h);
+        *h = NULL;
+    }
+    return;
+}
+
+/* returns the backend of the Hasher */
+HashBackend hasher_backend(Hasher *h) {
+    return h ? h->backend : SPECK;
+}
+
+/* helper function: 64x64 -> 128 bit multiply, returned as the two halves */
+static inline void wy_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128_t;
+    uint128_t r = (uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    /* schoolbook multiply on 32 bit halves */
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/* helper function: multiply and fold the 128 bit product into 64 bits */
+static inline uint64_t wy_mix(uint64_t a, uint64_t b) {
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+/* helpers for unaligned little endian reads */
+static inline uint64_t wy_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t wy_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* reads 1 to 3 bytes (first, middle and last byte) */
+static inline uint64_t wy_r3(const uint8_t *p, uint32_t k) {
+    return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
+}
+
+/* wyhash-style digest: one pass over the key, two 64 bit outputs from the final state */
+static Digest wy_hash(uint64_t seed, const char *key, uint32_t length) {
+    const uint8_t *p = (const uint8_t *) key;
+    uint64_t a, b;
+
+    seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+
+    if (length <= 16) {
+        if (length >= 4) {
+            uint32_t off = (length >> 3) << 2; // 0 for 4..7 bytes, 4 for 8..16 bytes
+            a = (wy_r4(p) << 32) | wy_r4(p + off);
+            b = (wy_r4(p + length - 4) << 32) | wy_r4(p + length - 4 - off);
+        } else if (length > 0) {
+            a = wy_r3(p, length);
+            b = 0;
+        } else
+            a = b = 0;
+    } else {
+        uint32_t i = length;
+
+        /* consume 16 bytes at a time, the last (overlapping) 16 are mixed below */
+        while (i > 16) {
+            seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        a = wy_r8(p + i - 16);
+        b = wy_r8(p + i - 8);
+    }
+
+    a ^= wy_secret[1];
+    b ^= seed;
+    wy_mum(&a, &b);
+
+    Digest d;
+    d.lo = wy_mix(a ^ wy_secret[0] ^ length, b ^ wy_secret[1]);
+    d.hi = wy_mix(a ^ wy_secret[2], b ^ wy_secret[3] ^ length);
+    return d;
+}
+
+/* computes the digest of key (length bytes) with the Hasher's backend */
+Digest hasher_digest(Hasher *h, const char *key, uint32_t length) {
+    switch (h->backend) {
+    case WYHASH: return wy_hash(h->seed, key, length);
+    default: return speck_hash(h->rk, key, length);
+    }
+}
+
+/* returns the name of a backend */
+const char *backend_name(HashBackend backend) {
+    return backend < NUM_BACKENDS ? names[backend] : "unknown";
+}
+
+/* parses a backend name. returns false if it is not a known backend */
+bool backend_parse(const char *name, HashBackend *backend) {
+    for (uint32_t i = 0; i < NUM_BACKENDS; i++) {
+        if (!strcmp(name, names[i])) {
+            *backend = (HashBackend) i;
+            return true;
+        }
+    }
+    return false;
+}
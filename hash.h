@@ -0,0 +1,45 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* number of Bloom filter indices taken from a digest (indices 0 .. 2) */
+#define DIGEST_BF_PROBES 3
+
+/* the digest index used for the hash table bucket (the one after the BF's) */
+#define DIGEST_HT_PROBE DIGEST_BF_PROBES
+
+/* 128 bit digest of a word. computed once and shared by the BF and HT */
+typedef struct Digest {
+    uint64_t lo;
+    uint64_t hi;
+} Digest;
+
+/* hash functions a Hasher can be backed by */
+typedef enum HashBackend {
+    SPECK = 0, // keyed Speck cipher (collision resistant, the lab's hash)
+    WYHASH, // fast 64 bit multiply-mix hash (not cryptographic)
+    NUM_BACKENDS
+} HashBackend;
+
+typedef struct Hasher Hasher;
+
+Hasher *hasher_create(HashBackend backend, uint64_t *salt);
+
+void hasher_delete(Hasher **h);
+
+HashBackend hasher_backend(Hasher *h);
+
+Digest hasher_digest(Hasher *h, const char *key, uint32_t length);
+
+const char *backend_name(HashBackend backend);
+
+bool backend_parse(const char *name, HashBackend *backend);
+
+/* returns the i-th index of a digest by double hashing (Kirsch-Mitzenmacher) */
+static inline uint64_t digest_index(const Digest *d, uint32_t i) {
+    return d->lo + (uint64_t) i * d->hi;
+}
+
+#endif
@@ -1,122 +1,643 @@
 #include "ht.h"
 
+#include "arena.h"
+#include "hash.h"
 #include "ll.h"
-#include "speck.h"
+#include "node.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-/* tracks the number of non-null linked lists in HT (used by ht_count) */
-uint32_t total_lls = 0;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-/* credits: provided in the lab documentation */
-/* HashTable (HT) definition */
+#define GROUP       16 // slots whose control bytes are probed together
+#define EMPTY       0x80 // control byte of an empty slot (tags are 0 .. 0x7f)
+#define DELETED     0xfe // control byte of a removed word's slot (probing goes on past it)
+#define INLINE_KEY  16 // words shorter than this are stored in the slot itself
+#define REHASH_STEP 4 // buckets (or slots) moved to the new table per insert
+#define ARENA_CHUNK 65536 // bytes the arena grabs at a time
+
+/*
+ * a slot of the open addressing table (one cache line). the node is what
+ * ht_lookup returns, so its oldspeak points at key when the word is short.
+ */
+typedef struct Slot {
+    Node node; // node.length is the length of oldspeak
+    char key[INLINE_KEY]; // inline copy of a short oldspeak
+} Slot;
+
+/* one generation of buckets (chained LLs or open addressing slots) */
+typedef struct Table {
+    uint32_t size; // buckets or slots
+    LinkedList **lists; // array of linkedlist (LL) pointers (chained)
+    uint8_t *ctrl; // 7 bit hash tag or EMPTY per slot (open addressing)
+    Slot *slots; // flat slot array (open addressing)
+    uint32_t tombstones; // DELETED slots (open addressing)
+} Table;
+
+/*
+ * credits: based on the definition provided in the lab documentation
+ * HashTable (HT) definition. the bucket index comes from the word's digest.
+ * when the load passes its threshold a table twice the size is made and the
+ * words are moved over a few buckets per insert (like redis' dict), so no
+ * single insert pays for the whole rehash. lookups check both tables.
+ * the LLs, nodes and strings are bump allocated from the HT's arena.
+ */
 struct HashTable {
-    uint64_t salt[2]; // salt for the hash function
-    uint32_t size; // size of the table
     bool mtf; // move to front ll or not
-    LinkedList **lists; // array of linkedlist (LL) pointers
+    bool open; // open addressing or chained LLs
+    Arena *arena; // owns every LL, node and string in the HT
+    uint32_t entries; // number of words in the HT
+    uint32_t total_lls; // number of non-null linked lists in HT (used by ht_count)
+    Table tables[2]; // [0] is the table, [1] the bigger one while rehashing
+    uint32_t rehash; // next bucket of tables[0] to move (while rehashing)
+    size_t peak; // most bytes the HT has held (for stats)
 };
 
+/* helper function: smallest power of 2 >= n (and >= GROUP) */
+static uint32_t slot_capacity(uint32_t n) {
+    uint32_t cap = GROUP;
+    while (cap < n && cap < (1u << 31))
+        cap <<= 1;
+    return cap;
+}
+
+/* helper function that allocates an empty table of the given size */
+static bool table_alloc(Table *t, uint32_t size, bool open) {
+    t->lists = NULL;
+    t->ctrl = NULL;
+    t->slots = NULL;
+    t->tombstones = 0;
+
+    /* open addressing: size is rounded up to a power of 2 */
+    if (open) {
+        t->size = slot_capacity(size);
+        t->ctrl = (uint8_t *) malloc(t->size);
+        t->slots = (Slot *) calloc(t->size, sizeof(Slot));
+        if (!t->ctrl || !t->slots) {
+            free(t->ctrl);
+            free(t->slots);
+            t->ctrl = NULL;
+            t->slots = NULL;
+            return false;
+        }
+        memset(t->ctrl, EMPTY, t->size);
+        return true;
+    }
+
+    t->size = size;
+    t->lists = (LinkedList **) calloc(size, sizeof(LinkedList *)); // array of ll pointers
+    return t->lists != NULL;
+}
+
+/* helper function that frees a table (its words are freed with the arena) */
+static void table_free(Table *t) {
+    free(t->ctrl);
+    free(t->slots);
+    free(t->lists);
+    t->ctrl = NULL;
+    t->slots = NULL;
+    t->lists = NULL;
+    t->size = 0;
+    return;
+}
+
+/* helper function that returns the bytes of a table's buckets (its words are in the arena) */
+static size_t table_bytes(Table *t) {
+    if (t->slots)
+        return (size_t) t->size * (sizeof(Slot) + 1);
+    return (size_t) t->size * sizeof(LinkedList *);
+}
+
+/* helper function that returns the bytes the HT holds now */
+static size_t current_bytes(HashTable *ht) {
+    return sizeof(HashTable) + table_bytes(&(ht->tables[0])) + table_bytes(&(ht->tables[1]))
+           + arena_reserved(ht->arena);
+}
+
+/* helper function that remembers the bytes the HT holds now if they are the most so far */
+static void track_peak(HashTable *ht) {
+    size_t bytes = current_bytes(ht);
+    ht->peak = bytes > ht->peak ? bytes : ht->peak;
+}
+
+/* helper function: true while words are being moved to tables[1] */
+static inline bool rehashing(HashTable *ht) {
+    return ht->tables[1].size != 0;
+}
+
 /* credits: provided in the lab documentation */
-/* constructor for the HT */
-HashTable *ht_create(uint32_t size, bool mtf) {
+/* constructor for the HT. open selects open addressing over chained LLs */
+/* size is only the initial size: the HT grows as words are added */
+HashTable *ht_create(uint32_t size, bool mtf, bool open) {
     HashTable *ht = (HashTable *) malloc(sizeof(HashTable));
 
     if (ht) {
-        /* salt from the lab doc */
-        ht->salt[0] = 0x9846e4f157fe8840;
-        ht->salt[1] = 0xc5f318d7e055afb8;
-
-        ht->size = size;
         ht->mtf = mtf;
-
-        ht->lists = (LinkedList **) calloc(size, sizeof(LinkedList *)); // array of ll pointers
+        ht->open = open;
+        ht->entries = 0;
+        ht->total_lls = 0;
+        ht->rehash = 0;
+        ht->tables[1] = (Table) { 0, NULL, NULL, NULL, 0 }; // not rehashing
+        ht->arena = arena_create(ARENA_CHUNK);
+        ht->peak = 0;
 
         /* cannot allocate memory */
-        if (!ht->lists) {
+        if (!size || !ht->arena || !table_alloc(&(ht->tables[0]), size, open)) {
+            arena_delete(&(ht->arena));
             free(ht);
             ht = NULL;
-        }
+        } else
+            track_peak(ht);
     }
 
     return ht;
 }
 
-/* destructor for the HT */
+/* destructor for the HT. every word goes at once with the arena */
 void ht_delete(HashTable **ht) {
 
-    if (ht && *ht && (*ht)->lists) {
-        for (uint32_t i = 0; i < (*ht)->size; i++) {
-            ll_delete(&((*ht)->lists[i])); // delete each linked list
-        }
+    if (ht && *ht) {
+        table_free(&((*ht)->tables[0]));
+        table_free(&((*ht)->tables[1]));
+        arena_delete(&((*ht)->arena));
 
-        /* free the array and the ht */
-        free((*ht)->lists);
         free((*ht));
         *ht = NULL;
-
-        total_lls = 0; // reset the count
     }
 
     return;
 }
 
-/* returns the size of the HT */
+/* returns the size of the HT (the size it is growing into while rehashing) */
 uint32_t ht_size(HashTable *ht) {
     if (!ht)
         return 0; // no ht
-    return ht->size;
+    return ht->tables[rehashing(ht)].size;
 }
 
-/* looks up if node is in the LL in the HT */
-Node *ht_lookup(HashTable *ht, char *oldspeak) {
-    if (!ht || !oldspeak)
-        return NULL; // safety check
+/* checks if the HT is open addressing (false: chained LLs) */
+bool ht_open_addressing(HashTable *ht) {
+    return ht && ht->open;
+}
+
+/* helper function: bitmask of the slots in a group whose control byte is c */
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t c) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128((const __m128i *) ctrl);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) c)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < GROUP; i++)
+        mask |= (uint32_t) (ctrl[i] == c) << i;
+    return mask;
+#endif
+}
+
+/* helper function: bitmask of the slots in a group that are EMPTY or DELETED */
+static inline uint32_t group_free(const uint8_t *ctrl) {
+#ifdef __SSE2__
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < GROUP; i++)
+        mask |= (uint32_t) (ctrl[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+/* helper function: true if slot i holds a word (its control byte is a tag) */
+static inline bool slot_used(Table *t, uint32_t i) {
+    return t->ctrl[i] < EMPTY;
+}
+
+/* helper function to get the 7 bit tag of a word's hash */
+static inline uint8_t hash_tag(uint64_t h) {
+    return (uint8_t) (h >> 57);
+}
 
-    uint32_t index = hash(ht->salt, oldspeak) % ht->size; // get the linked list index by hashing
+/*
+ * helper function that finds the slot of oldspeak (length bytes, hash h).
+ * groups are probed in triangular order, so every group is visited once.
+ * returns NULL if the word is not in the table.
+ */
+static Slot *slot_find(Table *t, uint64_t h, const char *oldspeak, uint32_t length, Stats *stats) {
+    uint32_t mask = t->size / GROUP - 1, g = (uint32_t) h & mask;
+    uint8_t tag = hash_tag(h);
+
+    for (uint32_t step = 1;; step++) {
+        const uint8_t *ctrl = t->ctrl + g * GROUP;
+
+        /* compare the words of the slots whose tag matches */
+        for (uint32_t m = group_match(ctrl, tag); m; m &= m - 1) {
+            Slot *s = t->slots + g * GROUP + __builtin_ctz(m);
+            if (s->node.length == length && !memcmp(s->node.oldspeak, oldspeak, length))
+                return s;
+            if (stats)
+                stats->links++; // a tag collision costs a compare, like a link in a LL
+        }
+
+        /* an empty slot ends the probe sequence */
+        if (group_match(ctrl, EMPTY) || step > mask)
+            return NULL;
+
+        g = (g + step) & mask;
+        if (stats)
+            stats->links++; // moved on to another group
+    }
+}
+
+/* helper function that returns the first empty or deleted slot in the probe sequence of h */
+static Slot *slot_free(Table *t, uint64_t h) {
+    uint32_t mask = t->size / GROUP - 1, g = (uint32_t) h & mask;
+
+    for (uint32_t step = 1;; step++) {
+        uint32_t m = group_free(t->ctrl + g * GROUP);
+        if (m) {
+            uint32_t i = g * GROUP + (uint32_t) __builtin_ctz(m);
+            if (t->ctrl[i] == DELETED)
+                t->tombstones--;
+            t->ctrl[i] = hash_tag(h);
+            return &(t->slots[i]);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+/* helper function that moves a used slot into a free slot of table t */
+static void slot_move(Table *t, Slot *from) {
+    Slot *to = slot_free(t, from->node.hash);
+    *to = *from;
+
+    /* the inline key moved with the slot */
+    if (from->node.oldspeak == from->key)
+        to->node.oldspeak = to->key;
+    return;
+}
+
+/* helper function that finds the node of oldspeak in one table */
+static Node *table_find(Table *t, uint64_t h, const char *oldspeak, uint32_t length, Stats *stats) {
+    if (t->slots) {
+        Slot *s = slot_find(t, h, oldspeak, length, stats);
+        return s ? &(s->node) : NULL;
+    }
+
+    LinkedList *ll = t->lists[h % t->size]; // get the linked list at the index
 
     /* if no LL at that index return NULL, else lookup in LL and return the result */
-    if (!(ht->lists[index]))
-        return NULL;
+    return ll ? ll_lookup(ll, oldspeak, length, stats) : NULL;
+}
+
+/* helper function that moves the next n buckets of tables[0] into tables[1] */
+static void rehash_step(HashTable *ht, uint32_t n) {
+    Table *from = &(ht->tables[0]), *to = &(ht->tables[1]);
+
+    for (; n && ht->rehash < from->size; n--, ht->rehash++) {
+        uint32_t i = ht->rehash;
+
+        /* a moved slot is DELETED, not EMPTY: words after it may still be probed for in from */
+        if (from->slots) {
+            if (slot_used(from, i)) {
+                slot_move(to, &(from->slots[i]));
+                from->ctrl[i] = DELETED;
+            }
+            continue;
+        }
+
+        LinkedList *ll = from->lists[i];
+        if (!ll)
+            continue;
+
+        /* relink each node into its new bucket (no copies) */
+        Node *node;
+        while ((node = ll_pop(ll))) {
+            uint32_t index = node->hash % to->size;
+            if (!to->lists[index]) {
+                to->lists[index] = ll_create(ht->mtf, ht->arena);
+                ht->total_lls++;
+            }
+            ll_push(to->lists[index], node);
+        }
+
+        from->lists[i] = NULL; // the empty LL stays in the arena
+        ht->total_lls--;
+    }
+
+    /* every bucket moved: the new table takes over */
+    if (ht->rehash >= from->size) {
+        table_free(from);
+        *from = *to;
+        to->size = 0;
+        to->lists = NULL;
+        to->ctrl = NULL;
+        to->slots = NULL;
+        ht->rehash = 0;
+    }
+
+    return;
+}
+
+/* helper function that starts a rehash into a table twice the size if the HT is too loaded */
+static void maybe_grow(HashTable *ht) {
+    Table *t = &(ht->tables[rehashing(ht)]);
+
+    /* chained LLs grow past one word per bucket, slots past 7/8 load (deleted ones included) */
+    uint64_t limit = ht->open ? (uint64_t) t->size * 7 / 8 : t->size;
+    if ((uint64_t) ht->entries + t->tombstones + 1 <= limit || t->size >= (1u << 30))
+        return;
+
+    /* still moving words from the last growth (cannot happen with REHASH_STEP >= 2) */
+    while (rehashing(ht))
+        rehash_step(ht, UINT32_MAX);
+
+    /* mostly tombstones: rehashing into the same size is enough to clear them */
+    uint32_t size = ht->tables[0].size;
+    if ((uint64_t) ht->entries + 1 > limit / 2)
+        size *= 2;
+
+    Table bigger;
+    if (table_alloc(&bigger, size, ht->open)) {
+        ht->tables[1] = bigger;
+        ht->rehash = 0;
+
+        track_peak(ht); // both tables are held until the rehash is done
+    }
+
+    return;
+}
+
+/* looks up if node is in the LL in the HT (d is the digest of oldspeak) */
+Node *ht_lookup(HashTable *ht, Digest *d, const char *oldspeak, uint32_t length, Stats *stats) {
+    if (!ht || !d || !oldspeak)
+        return NULL; // safety check
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+
+    if (ht->open && stats)
+        stats->seeks++; // ll_lookup counts the seeks of chained LLs
+
+    /* the word may not have been moved to the new table yet */
+    Node *n = table_find(&(ht->tables[0]), h, oldspeak, length, stats);
+    if (!n && rehashing(ht))
+        n = table_find(&(ht->tables[1]), h, oldspeak, length, stats);
+
+    return n;
+}
+
+/* helper function that starts loading the bucket (or first group) of hash h into the cache */
+static inline void table_prefetch(Table *t, uint64_t h) {
+    if (t->slots)
+        __builtin_prefetch(t->ctrl + ((uint32_t) h & (t->size / GROUP - 1)) * GROUP);
     else
-        return ll_lookup(ht->lists[index], oldspeak);
+        __builtin_prefetch(&(t->lists[h % t->size]));
+}
+
+/* starts loading where the word with digest d would be into the cache (see ht_lookup_batch) */
+void ht_prefetch(HashTable *ht, Digest *d) {
+    if (!ht || !d)
+        return;
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+    table_prefetch(&(ht->tables[0]), h);
+    if (rehashing(ht))
+        table_prefetch(&(ht->tables[1]), h);
+    return;
 }
 
-/* adds a node with the given parameters into a HT LinkedList */
-void ht_insert(HashTable *ht, char *oldspeak, char *newspeak) {
-    if (!ht || !oldspeak)
+/*
+ * looks up n words at once, setting found[i] to ht_lookup(ht, &d[i], oldspeak[i], lengths[i]).
+ * the buckets of the whole batch are prefetched first so their misses overlap.
+ */
+void ht_lookup_batch(HashTable *ht, Digest *d, char **oldspeak, uint32_t *lengths, uint32_t n,
+    Node **found, Stats *stats) {
+    if (!ht || !d || !oldspeak || !lengths || !found)
         return; // safety check
 
-    uint32_t index = hash(ht->salt, oldspeak) % ht->size; // get the linked list index by hashing
-    LinkedList *ll = ht->lists[index]; // list at the index
+    for (uint32_t i = 0; i < n; i++)
+        ht_prefetch(ht, &d[i]);
+
+    for (uint32_t i = 0; i < n; i++)
+        found[i] = ht_lookup(ht, &d[i], oldspeak[i], lengths[i], stats);
+
+    return;
+}
+
+/* adds a node with the given parameters into a HT LinkedList (d is the digest of oldspeak) */
+/* nodes of the open addressing table may move when a word is inserted */
+void ht_insert(HashTable *ht, Digest *d, char *oldspeak, char *newspeak) {
+    if (!ht || !d || !oldspeak)
+        return; // safety check
+
+    uint32_t length = (uint32_t) strlen(oldspeak);
+
+    /* words are not replaced, like ll_insert */
+    if (ht_lookup(ht, d, oldspeak, length, NULL))
+        return;
+
+    maybe_grow(ht);
+    if (rehashing(ht))
+        rehash_step(ht, REHASH_STEP);
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+    Table *t = &(ht->tables[rehashing(ht)]); // new words go to the newest table
+
+    if (t->slots) {
+        /* short words live in the slot, longer ones are copied into the arena (before a slot is claimed) */
+        char *key = length < INLINE_KEY ? NULL : arena_strndup(ht->arena, oldspeak, length);
+        char *translation = newspeak ? arena_strndup(ht->arena, newspeak, strlen(newspeak)) : NULL;
+
+        /* could not allocate memory */
+        if ((length >= INLINE_KEY && !key) || (newspeak && !translation))
+            return;
+
+        Slot *s = slot_free(t, h);
+
+        s->node.next = NULL;
+        s->node.prev = NULL;
+        s->node.hash = h;
+        s->node.length = length;
+
+        if (key)
+            s->node.oldspeak = key;
+        else {
+            memcpy(s->key, oldspeak, length + 1);
+            s->node.oldspeak = s->key;
+        }
+        s->node.newspeak = translation;
+
+        ht->entries++;
+        track_peak(ht);
+        return;
+    }
+
+    uint32_t index = h % t->size; // get the linked list index
+    LinkedList *ll = t->lists[index]; // list at the index
 
     /* no linked list, make one and add it to the HT */
     if (!ll) {
-        ll = ll_create(ht->mtf);
-        ht->lists[index] = ll;
-        total_lls++; // was null now it is not. therefore increment
+        ll = ll_create(ht->mtf, ht->arena);
+        t->lists[index] = ll;
+        ht->total_lls++; // was null now it is not. therefore increment
     }
 
-    ll_insert(ll, oldspeak, newspeak); // insert in the list
+    /* insert in the list (already known not to be in it, so no ll_insert lookup) */
+    Node *n = node_create(oldspeak, newspeak, ht->arena);
+    if (n) {
+        n->hash = h;
+        ll_push(ll, n);
+        ht->entries++;
+    }
+
+    track_peak(ht);
 
     return;
 }
 
-/* returns number of LLs added in the HT */
+/*
+ * removes the word oldspeak (length bytes, d is its digest) from the HT.
+ * returns false if it is not in the HT. its strings stay in the arena until
+ * the HT is deleted, and with open addressing its slot is marked DELETED (or
+ * EMPTY when no probe can have gone past its group) until an insert reuses it.
+ */
+bool ht_remove(HashTable *ht, Digest *d, const char *oldspeak, uint32_t length) {
+    if (!ht || !d || !oldspeak)
+        return false; // safety check
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+
+    for (uint32_t k = 0; k <= (uint32_t) rehashing(ht); k++) {
+        Table *t = &(ht->tables[k]);
+
+        if (t->slots) {
+            Slot *s = slot_find(t, h, oldspeak, length, NULL);
+            if (!s)
+                continue;
+
+            uint32_t i = (uint32_t) (s - t->slots);
+            if (group_match(t->ctrl + i / GROUP * GROUP, EMPTY))
+                t->ctrl[i] = EMPTY; // every probe through this group stopped in it
+            else {
+                t->ctrl[i] = DELETED;
+                t->tombstones++;
+            }
+            ht->entries--;
+            return true;
+        }
+
+        uint32_t index = h % t->size;
+        LinkedList *ll = t->lists[index];
+        if (!ll_remove(ll, oldspeak, length))
+            continue;
+
+        /* an emptied LL stays in the arena, its bucket is free again */
+        if (!ll_length(ll)) {
+            t->lists[index] = NULL;
+            ht->total_lls--;
+        }
+        ht->entries--;
+        return true;
+    }
+
+    return false;
+}
+
+/* returns number of LLs added in the HT (or used slots with open addressing) */
 uint32_t ht_count(HashTable *ht) {
     if (!ht)
         return 0; // no ht
-    return total_lls; // variable that has been tracking non-null LLs
+    if (ht->open)
+        return ht->entries;
+    return ht->total_lls; // variable that has been tracking non-null LLs
+}
+
+/* calls visit on the node of every word in the HT */
+void ht_foreach(HashTable *ht, void (*visit)(Node *n, void *arg), void *arg) {
+    if (!ht || !visit)
+        return;
+
+    for (uint32_t k = 0; k < 2; k++) {
+        Table *t = &(ht->tables[k]);
+        for (uint32_t i = 0; i < t->size; i++) {
+            if (t->slots && slot_used(t, i))
+                visit(&(t->slots[i].node), arg);
+            if (t->lists && t->lists[i])
+                ll_foreach(t->lists[i], visit, arg);
+        }
+    }
+    return;
+}
+
+/* returns the arena that holds the HT's words (for stats) */
+Arena *ht_arena(HashTable *ht) {
+    return ht ? ht->arena : NULL;
+}
+
+/* returns the most bytes the HT has held (its tables and arena, for stats) */
+size_t ht_bytes(HashTable *ht) {
+    return ht ? ht->peak : 0;
+}
+
+/* helper function that returns the number of groups probed to find the word in slot i */
+static uint32_t probe_length(Table *t, uint32_t i) {
+    uint32_t mask = t->size / GROUP - 1, g = (uint32_t) t->slots[i].node.hash & mask;
+    uint32_t length = 1;
+
+    for (uint32_t step = 1; g != i / GROUP; step++, length++)
+        g = (g + step) & mask;
+    return length;
+}
+
+/*
+ * counts the chain lengths of the HT into bins (n of them, the last one
+ * counts every length >= n - 1): the words in each bucket (empty ones
+ * included) with chained LLs, or the groups probed to find each word with
+ * open addressing.
+ */
+void ht_histogram(HashTable *ht, uint64_t *bins, uint32_t n) {
+    if (!ht || !bins || !n)
+        return;
+
+    memset(bins, 0, n * sizeof(uint64_t));
+
+    for (uint32_t k = 0; k < 2; k++) {
+        Table *t = &(ht->tables[k]);
+        for (uint32_t i = 0; i < t->size; i++) {
+            uint32_t length;
+            if (t->slots) {
+                if (!slot_used(t, i))
+                    continue;
+                length = probe_length(t, i);
+            } else
+                length = t->lists[i] ? ll_length(t->lists[i]) : 0;
+            bins[length < n - 1 ? length : n - 1]++;
+        }
+    }
+    return;
+}
+
+/* returns the number of words in the HT */
+uint32_t ht_entries(HashTable *ht) {
+    return ht ? ht->entries : 0;
 }
 
 /* prints the HT (only non null LLs) */
 void ht_print(HashTable *ht) {
-    for (uint32_t i = 0; i < ht->size; i++) {
-        fprintf(stdout, "\n[%u]\n", i); // to make it more clear
-        ll_print(ht->lists[i]); // print each ll (will only print if ll not null)
+    for (uint32_t k = 0; k < 2; k++) {
+        Table *t = &(ht->tables[k]);
+        for (uint32_t i = 0; i < t->size; i++) {
+            if (t->slots) {
+                if (slot_used(t, i))
+                    node_print(&(t->slots[i].node)); // print each used slot
+                continue;
+            }
+            fprintf(stdout, "\n[%u]\n", i); // to make it more clear
+            ll_print(t->lists[i]); // print each ll (will only print if ll not null)
+        }
     }
     return;
 }
@@ -2,24 +2,47 @@
 #define __HT_H__
 
 #include "ll.h"
+#include "arena.h"
+#include "hash.h"
+#include "stats.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct HashTable HashTable;
 
-HashTable *ht_create(uint32_t size, bool mtf);
+HashTable *ht_create(uint32_t size, bool mtf, bool open);
 
 void ht_delete(HashTable **ht);
 
 uint32_t ht_size(HashTable *ht);
 
-Node *ht_lookup(HashTable *ht, char *oldspeak);
+bool ht_open_addressing(HashTable *ht);
 
-void ht_insert(HashTable *ht, char *oldspeak, char *newspeak);
+Node *ht_lookup(HashTable *ht, Digest *d, const char *oldspeak, uint32_t length, Stats *stats);
+
+void ht_prefetch(HashTable *ht, Digest *d);
+
+void ht_lookup_batch(HashTable *ht, Digest *d, char **oldspeak, uint32_t *lengths, uint32_t n,
+    Node **found, Stats *stats);
+
+void ht_insert(HashTable *ht, Digest *d, char *oldspeak, char *newspeak);
+
+bool ht_remove(HashTable *ht, Digest *d, const char *oldspeak, uint32_t length);
 
 uint32_t ht_count(HashTable *ht);
 
+uint32_t ht_entries(HashTable *ht);
+
+Arena *ht_arena(HashTable *ht);
+
+size_t ht_bytes(HashTable *ht);
+
+void ht_histogram(HashTable *ht, uint64_t *bins, uint32_t n);
+
+void ht_foreach(HashTable *ht, void (*visit)(Node *n, void *arg), void *arg);
+
 void ht_print(HashTable *ht);
 
 #endif
@@ -0,0 +1,239 @@
+#include "input.h"
+
+#include "parser.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * The input is handed out in chunks that are views, never copies of single
+ * words: a regular file is mapped whole and cut into chunks in place, other
+ * inputs (pipes, terminals) are read into one large buffer. every chunk ends
+ * where words_split says the text can be cut (not inside an obfuscated word
+ * either, see input_join; or after a record's delimiter, see input_delimit),
+ * so the words of a file are the same however it is chunked, and the start
+ * of a word that runs past the end of a read is carried over into the next
+ * chunk.
+ */
+
+/* Input definition */
+struct Input {
+    int fd;
+    const char *map; // the mapped file (NULL if read)
+    uint64_t map_size; // bytes mapped
+    uint64_t pos; // next byte of the mapping to hand out
+    char *buffer; // read buffer (also holds the end of a mapped file)
+    uint64_t capacity; // bytes the buffer can hold (plus WORDS_PADDING)
+    uint64_t size; // bytes in the buffer
+    uint64_t handed; // bytes of the buffer handed out by the last input_next
+    bool eof; // read everything
+    bool stream; // hand out what arrived instead of waiting for want bytes
+    bool delimited; // chunks end after a delimiter instead of between words
+    char delimiter;
+    bool joined; // chunks do not end inside an obfuscated word either (see input_join)
+    bool inner[256];
+};
+
+/*
+ * constructor for the Input of fd (mapped if it is a regular file). a stream
+ * is never mapped, and its chunks are handed out as soon as a read returns
+ * whole words, so text that trickles in is filtered when it arrives.
+ */
+Input *input_open(int fd, bool stream) {
+    Input *in = (Input *) malloc(sizeof(Input));
+
+    if (in) {
+        in->fd = fd;
+        in->map = NULL;
+        in->map_size = 0;
+        in->pos = 0;
+        in->buffer = NULL;
+        in->capacity = 0;
+        in->size = 0;
+        in->handed = 0;
+        in->eof = false;
+        in->stream = stream;
+        in->delimited = false;
+        in->delimiter = '\0';
+        in->joined = false;
+
+        /* map regular files (from where fd is at), read the rest */
+        struct stat st;
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (!stream && !fstat(fd, &st) && S_ISREG(st.st_mode) && offset >= 0 && st.st_size > offset) {
+            void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+                in->map = (const char *) map;
+                in->map_size = (uint64_t) st.st_size;
+                in->pos = (uint64_t) offset;
+            }
+        }
+    }
+
+    return in;
+}
+
+/* destructor for an Input */
+void input_close(Input **in) {
+    if (in && *in) {
+        if ((*in)->map)
+            munmap((void *) (*in)->map, (size_t) (*in)->map_size);
+        free((*in)->buffer);
+        free(*in);
+        *in = NULL;
+    }
+    return;
+}
+
+/*
+ * makes the chunks of the Input end right after a delimiter instead of
+ * between words, so records that end with it are never split (see record.h).
+ * only the last chunk of the input may end without one.
+ */
+void input_delimit(Input *in, char delimiter) {
+    if (in) {
+        in->delimited = true;
+        in->delimiter = delimiter;
+    }
+    return;
+}
+
+/*
+ * makes the chunks of the Input not end inside an obfuscated word: inner holds
+ * the bytes that join its words (see normalizer_joiners), NULL if none. it is
+ * copied, so it can be changed for the next chunk.
+ */
+void input_join(Input *in, const bool *inner) {
+    if (in) {
+        in->joined = inner != NULL;
+        if (inner)
+            memcpy(in->inner, inner, sizeof(in->inner));
+    }
+    return;
+}
+
+/* helper function that returns where a chunk of text (size bytes) can end (0 if nowhere) */
+static uint64_t split(Input *in, const char *text, uint64_t size) {
+    if (!in->delimited)
+        return words_split(text, size, in->joined ? in->inner : NULL);
+
+    for (uint64_t p = size; p-- > 0;) {
+        if (text[p] == in->delimiter)
+            return p + 1;
+    }
+    return 0;
+}
+
+/* returns the bytes of the read buffer and sets mapped to the bytes mapped (for stats) */
+uint64_t input_bytes(Input *in, uint64_t *mapped) {
+    if (mapped)
+        *mapped = in ? in->map_size : 0;
+    return in && in->buffer ? in->capacity + WORDS_PADDING : 0;
+}
+
+/* helper function that makes room for capacity bytes (plus padding) in the buffer */
+static bool reserve(Input *in, uint64_t capacity) {
+    if (capacity <= in->capacity)
+        return true;
+
+    char *buffer = (char *) realloc(in->buffer, capacity + WORDS_PADDING);
+    if (!buffer)
+        return false;
+
+    in->buffer = buffer;
+    in->capacity = capacity;
+    return true;
+}
+
+/* helper function that hands out the first size bytes of the buffer */
+static const char *hand_out(Input *in, uint64_t size, uint64_t *out) {
+    memset(in->buffer + in->size, 0, WORDS_PADDING); // keep the SIMD scan's overread defined
+    in->handed = size;
+    *out = size;
+    return in->buffer;
+}
+
+/* helper function for input_next on a mapped file */
+static const char *next_mapped(Input *in, uint64_t want, uint64_t *size) {
+    uint64_t left = in->map_size - in->pos;
+    if (!left)
+        return NULL;
+
+    /* chunks are scanned in place, so they have to end WORDS_PADDING bytes before the mapping */
+    if (left > WORDS_PADDING) {
+        uint64_t usable = left - WORDS_PADDING;
+        uint64_t cut = split(in, in->map + in->pos, usable < want ? usable : want);
+        if (!cut && want < usable)
+            cut = split(in, in->map + in->pos, usable); // one very long word (or record)
+        if (cut) {
+            const char *chunk = in->map + in->pos;
+            in->pos += cut;
+            *size = cut;
+            return chunk;
+        }
+    }
+
+    /* the last bytes are copied into the buffer */
+    if (!reserve(in, left))
+        return NULL;
+    memcpy(in->buffer, in->map + in->pos, left);
+    in->pos = in->map_size;
+    in->size = left;
+    return hand_out(in, left, size);
+}
+
+/*
+ * returns the next chunk of the input, about want bytes (more if a word or
+ * record is longer), and sets size to its length. WORDS_PADDING bytes past its end are
+ * readable. the chunk stays valid until the next call. returns NULL at the end
+ * of the input (or if it cannot be read).
+ */
+const char *input_next(Input *in, uint64_t want, uint64_t *size) {
+    if (!in || !size)
+        return NULL;
+
+    if (!want)
+        want = 1;
+
+    if (in->map)
+        return next_mapped(in, want, size);
+
+    /* drop what was handed out last time, keeping the words it did not finish */
+    if (in->handed) {
+        memmove(in->buffer, in->buffer + in->handed, in->size - in->handed);
+        in->size -= in->handed;
+        in->handed = 0;
+    }
+
+    while (true) {
+        if (!reserve(in, in->size + want))
+            return NULL;
+
+        /* fill up to want bytes past what was carried over */
+        uint64_t goal = in->size + want;
+        while (!in->eof && in->size < goal) {
+            ssize_t n = read(in->fd, in->buffer + in->size, goal - in->size);
+            if (n > 0) {
+                in->size += (uint64_t) n;
+                if (in->stream)
+                    break; // no waiting for the rest
+            } else if (!n || errno != EINTR)
+                in->eof = true; // end of input (or an error, which ends it the same way)
+        }
+
+        if (in->eof)
+            return in->size ? hand_out(in, in->size, size) : NULL;
+
+        /* hand out whole words only, read more if the buffer is one word so far */
+        uint64_t cut = split(in, in->buffer, in->size);
+        if (cut)
+            return hand_out(in, cut, size);
+    }
+}
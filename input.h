@@ -0,0 +1,21 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Input Input;
+
+Input *input_open(int fd, bool stream);
+
+void input_close(Input **in);
+
+void input_delimit(Input *in, char delimiter);
+
+void input_join(Input *in, const bool *inner);
+
+const char *input_next(Input *in, uint64_t want, uint64_t *size);
+
+uint64_t input_bytes(Input *in, uint64_t *mapped);
+
+#endif
@@ -0,0 +1,246 @@
+#include "live.h"
+
+#include "dict.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/*
+ * A Live dictionary is a Dict that can be replaced while it is being read,
+ * published RCU style: readers load the current pointer and announce the
+ * Dict they use in their own slot (live_enter), so looking words up takes
+ * no lock and never waits. a publisher swaps the pointer and then waits,
+ * off the readers' path, until no slot holds the old Dict any more (the
+ * grace period) before deleting it. readers that entered before the swap
+ * finish on the old version, the next live_enter sees the new one.
+ */
+
+/* modification stamp of a watched file (all 0 if it does not exist) */
+typedef struct Stamp {
+    dev_t dev;
+    ino_t ino; // changes when the file is replaced by a rename
+    off_t size;
+    struct timespec mtime;
+} Stamp;
+
+/* Live definition */
+struct Live {
+    _Atomic(Dict *) current; // the published version
+    _Atomic(Dict *) *slots; // the version each reader is using (NULL if none)
+    uint32_t readers;
+    atomic_uint_fast64_t version; // number of versions published
+    pthread_mutex_t publish; // orders publishers (never taken by readers)
+
+    /* the reloading thread (see live_watch) */
+    pthread_t watcher;
+    bool watching;
+    atomic_bool stop;
+    sigset_t signals; // SIGHUP, taken by the watcher only
+    LiveBuild build;
+    void *arg;
+    const char **paths; // files whose changes trigger a reload
+    Stamp *stamps; // what they were at the last check
+    uint32_t n;
+};
+
+/* constructor for a Live dictionary that starts at dict (it owns it from now on) */
+Live *live_create(Dict *dict, uint32_t readers) {
+    if (!dict || !readers)
+        return NULL;
+
+    Live *l = (Live *) malloc(sizeof(Live));
+
+    if (l) {
+        l->slots = (_Atomic(Dict *) *) malloc(readers * sizeof(*(l->slots)));
+        if (!l->slots) {
+            free(l);
+            return NULL;
+        }
+
+        atomic_init(&(l->current), dict);
+        for (uint32_t i = 0; i < readers; i++)
+            atomic_init(&(l->slots[i]), NULL);
+        l->readers = readers;
+        atomic_init(&(l->version), 1);
+        pthread_mutex_init(&(l->publish), NULL);
+
+        l->watching = false;
+        atomic_init(&(l->stop), false);
+        l->stamps = NULL;
+    }
+
+    return l;
+}
+
+/* destructor for a Live dictionary (stops its watcher, no reader may be in it) */
+void live_delete(Live **l) {
+    if (l && *l) {
+        if ((*l)->watching) {
+            atomic_store(&((*l)->stop), true);
+            pthread_kill((*l)->watcher, SIGHUP); // wakes it from sigtimedwait
+            pthread_join((*l)->watcher, NULL);
+        }
+
+        Dict *d = atomic_load(&((*l)->current));
+        dict_delete(&d);
+        pthread_mutex_destroy(&((*l)->publish));
+        free((*l)->stamps);
+        free((*l)->slots);
+        free(*l);
+        *l = NULL;
+    }
+    return;
+}
+
+/*
+ * returns the current version for reader (0 .. readers - 1) to use until
+ * live_exit. it is announced before it is used and checked again after, so
+ * a publisher that swapped in between either sees the announcement or the
+ * reader retries with the new version.
+ */
+Dict *live_enter(Live *l, uint32_t reader) {
+    Dict *d = atomic_load(&(l->current));
+
+    while (true) {
+        atomic_store(&(l->slots[reader]), d);
+        Dict *now = atomic_load(&(l->current));
+        if (now == d)
+            return d;
+        d = now;
+    }
+}
+
+/* tells that reader is done with the version live_enter gave it */
+void live_exit(Live *l, uint32_t reader) {
+    atomic_store_explicit(&(l->slots[reader]), NULL, memory_order_release);
+    return;
+}
+
+/*
+ * makes dict the current version (the Live owns it from now on) and deletes
+ * the previous one once every reader that entered before the swap has exited.
+ * blocks for that grace period, so it must not be called between a
+ * live_enter and live_exit.
+ */
+void live_publish(Live *l, Dict *dict) {
+    if (!l || !dict)
+        return;
+
+    pthread_mutex_lock(&(l->publish));
+    Dict *old = atomic_exchange(&(l->current), dict);
+    atomic_fetch_add(&(l->version), 1);
+
+    for (uint32_t i = 0; i < l->readers; i++) {
+        while (atomic_load(&(l->slots[i])) == old)
+            poll(NULL, 0, 1);
+    }
+    pthread_mutex_unlock(&(l->publish));
+
+    dict_delete(&old);
+    return;
+}
+
+/* returns the number of versions published so far (the first one included) */
+uint64_t live_version(Live *l) {
+    return l ? atomic_load(&(l->version)) : 0;
+}
+
+/* helper function that reads the stamp of path */
+static Stamp stamp_of(const char *path) {
+    Stamp s;
+    struct stat st;
+
+    memset(&s, 0, sizeof(Stamp));
+    if (!stat(path, &st)) {
+        s.dev = st.st_dev;
+        s.ino = st.st_ino;
+        s.size = st.st_size;
+        s.mtime = st.st_mtim;
+    }
+
+    return s;
+}
+
+/* helper function that checks if any watched file changed since the last check */
+static bool changed(Live *l) {
+    bool any = false;
+
+    for (uint32_t i = 0; i < l->n; i++) {
+        Stamp s = stamp_of(l->paths[i]);
+        Stamp *t = &(l->stamps[i]);
+        if (s.dev != t->dev || s.ino != t->ino || s.size != t->size
+            || s.mtime.tv_sec != t->mtime.tv_sec || s.mtime.tv_nsec != t->mtime.tv_nsec)
+            any = true;
+        *t = s;
+    }
+
+    return any;
+}
+
+/*
+ * thread function of the watcher: reloads on SIGHUP, or once the watched
+ * files have changed and then stayed the same for a poll (so a file that is
+ * still being written is not loaded half way).
+ */
+static void *watch_run(void *arg) {
+    Live *l = (Live *) arg;
+    struct timespec wait = { LIVE_POLL_MS / 1000, (LIVE_POLL_MS % 1000) * 1000000L };
+    bool pending = false; // the files changed at the last check
+
+    while (!atomic_load(&(l->stop))) {
+        bool hup = sigtimedwait(&(l->signals), NULL, &wait) == SIGHUP;
+        if (atomic_load(&(l->stop)))
+            break;
+
+        bool now = changed(l);
+        bool reload = hup || (pending && !now);
+        pending = now;
+        if (!reload)
+            continue;
+
+        /* built on this thread, the readers keep going on the current version */
+        Dict *d = l->build(l->arg);
+        if (d)
+            live_publish(l, d);
+        else
+            fprintf(stderr, "Failed to reload the dictionary, keeping the current one.\n");
+    }
+
+    return NULL;
+}
+
+/*
+ * starts a thread that builds a new version with build(arg) and publishes it
+ * on SIGHUP or when one of the n files at paths changes. SIGHUP is blocked in
+ * the calling thread (and the threads it starts later), so call it before
+ * starting the readers. returns false if the thread cannot be started.
+ */
+bool live_watch(Live *l, LiveBuild build, void *arg, const char **paths, uint32_t n) {
+    if (!l || !build || l->watching)
+        return false;
+
+    l->build = build;
+    l->arg = arg;
+    l->paths = paths;
+    l->n = n;
+    l->stamps = (Stamp *) calloc(n ? n : 1, sizeof(Stamp));
+    if (!l->stamps)
+        return false;
+    changed(l); // the version published now is built from the files as they are
+
+    sigemptyset(&(l->signals));
+    sigaddset(&(l->signals), SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &(l->signals), NULL);
+
+    l->watching = !pthread_create(&(l->watcher), NULL, watch_run, l);
+    return l->watching;
+}
@@ -0,0 +1,31 @@
+#ifndef __LIVE_H__
+#define __LIVE_H__
+
+#include "dict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* how often the watched word files are checked for changes */
+#define LIVE_POLL_MS 500
+
+typedef struct Live Live;
+
+/* builds a fresh dictionary for a reload (NULL if it cannot) */
+typedef Dict *(*LiveBuild)(void *arg);
+
+Live *live_create(Dict *dict, uint32_t readers);
+
+void live_delete(Live **l);
+
+Dict *live_enter(Live *l, uint32_t reader);
+
+void live_exit(Live *l, uint32_t reader);
+
+void live_publish(Live *l, Dict *dict);
+
+bool live_watch(Live *l, LiveBuild build, void *arg, const char **paths, uint32_t n);
+
+uint64_t live_version(Live *l);
+
+#endif
@@ -7,11 +7,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX(a, b) (a > b ? a : b) // returns max
-
-/* extern var for stats */
-uint64_t seeks = 0; // number of seeks performed
-uint64_t links = 0; // number of links traversed
 
 /* credits: provided in the lab documentation */
 /* LinkedList (LL) definition */
@@ -20,23 +15,30 @@ struct LinkedList {
     Node *head; // sentinel nodes
     Node *tail;
     bool mtf; // move to front or not
+    Arena *arena; // where the LL and its nodes live (NULL for malloc)
 };
 
-/* constructor for the LL */
-LinkedList *ll_create(bool mtf) {
-    LinkedList *ll = (LinkedList *) malloc(sizeof(LinkedList));
+/* constructor for the LL. the LL and its nodes come from arena if it is not NULL */
+LinkedList *ll_create(bool mtf, Arena *arena) {
+    LinkedList *ll = arena ? (LinkedList *) arena_alloc(arena, sizeof(LinkedList))
+                           : (LinkedList *) malloc(sizeof(LinkedList));
 
     if (ll) {
         ll->length = 0;
         ll->mtf = mtf;
+        ll->arena = arena;
 
         /* create sentinel nodes */
-        ll->head = node_create(NULL, NULL);
-        ll->tail = node_create(NULL, NULL);
+        ll->head = node_create(NULL, NULL, arena);
+        ll->tail = node_create(NULL, NULL, arena);
 
         /* could not allocate memory */
         if (!ll->head || !ll->tail) {
-            free(ll);
+            if (!arena) {
+                node_delete(&(ll->head));
+                node_delete(&(ll->tail));
+                free(ll);
+            }
             ll = NULL;
         }
 
@@ -55,6 +57,12 @@ LinkedList *ll_create(bool mtf) {
 /* destructor for the LL */
 void ll_delete(LinkedList **ll) {
 
+    /* arena LLs are freed all at once with their arena */
+    if (ll && *ll && (*ll)->arena) {
+        *ll = NULL;
+        return;
+    }
+
     if (ll && *ll) {
 
         Node *curr = (*ll)->head->next; // tracks the curr node
@@ -101,44 +109,89 @@ static void move_to_front(LinkedList *ll, Node *n) {
     return;
 }
 
-/* looks up if node with given paramenters is in the LL */
-Node *ll_lookup(LinkedList *ll, char *oldspeak) {
-    seeks++; // update number of lookups performed
+/* looks up if node with given paramenters is in the LL (oldspeak is length bytes long) */
+/* the seek and the links it takes are counted in stats (if not NULL) */
+Node *ll_lookup(LinkedList *ll, const char *oldspeak, uint32_t length, Stats *stats) {
+    uint64_t traversed = 0; // links traversed
+
+    if (stats)
+        stats->seeks++; // update number of lookups performed
 
     if (!ll || !oldspeak)
         return NULL; // safety check
 
     Node *temp = ll->head->next;
-    size_t old_size = strlen(oldspeak);
     bool found = false;
 
     /* linearly search for oldspeak string */
     while (temp != ll->tail) {
 
-        /* found a match */
-        if (temp->oldspeak
-            && !strncmp(oldspeak, temp->oldspeak, MAX(old_size, strlen(temp->oldspeak)))) {
+        /* found a match (the lengths are compared first, so most nodes cost no string compare) */
+        if (temp->oldspeak && temp->length == length
+            && !memcmp(oldspeak, temp->oldspeak, length)) {
             found = true;
             break;
         }
 
         temp = temp->next;
-        links++; // increment links traversed
+        traversed++; // increment links traversed
     }
 
-    /* move to front if mtf == true */
-    if (ll->mtf && found)
+    if (stats)
+        stats->links += traversed;
+
+    /* move to front if mtf == true (counted if it was not there already) */
+    if (ll->mtf && found && traversed) {
         move_to_front(ll, temp);
+        if (stats)
+            stats->moves++;
+    }
 
     return found ? temp : NULL; // if node found, return it else null
 }
 
 /* adds a node with the given parameters after head sentinel node of the LL */
 void ll_insert(LinkedList *ll, char *oldspeak, char *newspeak) {
-    if (!ll || ll_lookup(ll, oldspeak))
+    if (!ll || !oldspeak || ll_lookup(ll, oldspeak, (uint32_t) strlen(oldspeak), NULL))
         return; // no LL or node already in LL
 
-    Node *n = node_create(oldspeak, newspeak); // else create a new node
+    Node *n = node_create(oldspeak, newspeak, ll->arena); // else create a new node
+
+    ll_push(ll, n);
+
+    return;
+}
+
+/*
+ * removes the node of oldspeak (length bytes) from the LL. returns false if
+ * it is not in the LL. nodes of an arena LL stay in the arena until it goes.
+ */
+bool ll_remove(LinkedList *ll, const char *oldspeak, uint32_t length) {
+    if (!ll || !oldspeak)
+        return false; // safety check
+
+    Node *n = ll->head->next;
+    while (n != ll->tail && !(n->length == length && !memcmp(oldspeak, n->oldspeak, length)))
+        n = n->next;
+
+    if (n == ll->tail)
+        return false; // not in the LL
+
+    /* unattach the node */
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+
+    ll->length--;
+
+    if (!ll->arena)
+        node_delete(&n);
+    return true;
+}
+
+/* attaches the node n after the head sentinel node of the LL */
+void ll_push(LinkedList *ll, Node *n) {
+    if (!ll || !n)
+        return;
 
     /* attach the node at the front */
     n->next = ll->head->next;
@@ -153,6 +206,35 @@ void ll_insert(LinkedList *ll, char *oldspeak, char *newspeak) {
     return;
 }
 
+/* detaches and returns the first node of the LL (NULL if it is empty) */
+Node *ll_pop(LinkedList *ll) {
+    if (!ll || !ll->length)
+        return NULL;
+
+    Node *n = ll->head->next;
+
+    /* unattach the node */
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->next = NULL;
+    n->prev = NULL;
+
+    ll->length--;
+
+    return n;
+}
+
+/* calls visit on each node of the LL (front to back) */
+void ll_foreach(LinkedList *ll, void (*visit)(Node *n, void *arg), void *arg) {
+    if (!ll || !visit)
+        return;
+
+    for (Node *temp = ll->head->next; temp != ll->tail; temp = temp->next)
+        visit(temp, arg);
+
+    return;
+}
+
 /* prints the LL */
 void ll_print(LinkedList *ll) {
     if (!ll)
@@ -1,26 +1,33 @@
 #ifndef __LINKEDLIST_H__
 #define __LINKEDLIST_H__
 
+#include "arena.h"
 #include "node.h"
+#include "stats.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 
-extern uint64_t seeks; // Number of seeks performed.
-extern uint64_t links; // Number of links traversed.
-
 typedef struct LinkedList LinkedList;
 
-LinkedList *ll_create(bool mtf);
+LinkedList *ll_create(bool mtf, Arena *arena);
 
 void ll_delete(LinkedList **ll);
 
 uint32_t ll_length(LinkedList *ll);
 
-Node *ll_lookup(LinkedList *ll, char *oldspeak);
+Node *ll_lookup(LinkedList *ll, const char *oldspeak, uint32_t length, Stats *stats);
 
 void ll_insert(LinkedList *ll, char *oldspeak, char *newspeak);
 
+bool ll_remove(LinkedList *ll, const char *oldspeak, uint32_t length);
+
+void ll_push(LinkedList *ll, Node *n);
+
+Node *ll_pop(LinkedList *ll);
+
+void ll_foreach(LinkedList *ll, void (*visit)(Node *n, void *arg), void *arg);
+
 void ll_print(LinkedList *ll);
 
 #endif
@@ -1,13 +1,15 @@
 #include "node.h"
 
+#include "arena.h"
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* constructor for a node */
-Node *node_create(char *oldspeak, char *newspeak) {
-    Node *n = (Node *) malloc(sizeof(Node));
+/* constructor for a node. the node and its strings come from arena if it is not NULL */
+Node *node_create(char *oldspeak, char *newspeak, Arena *arena) {
+    Node *n = arena ? (Node *) arena_alloc(arena, sizeof(Node)) : (Node *) malloc(sizeof(Node));
 
     if (n) {
 
@@ -16,22 +18,30 @@ Node *node_create(char *oldspeak, char *newspeak) {
         n->prev = NULL;
         n->oldspeak = NULL;
         n->newspeak = NULL;
+        n->hash = 0;
+        n->length = 0;
 
         /* copy oldspeak into node if possible using strndup */
         if (oldspeak) {
             size_t old_len = strlen(oldspeak); // size of the string
-            n->oldspeak = strndup(oldspeak, old_len); // copy it in oldspeak
+            n->length = (uint32_t) old_len;
+            n->oldspeak = arena ? arena_strndup(arena, oldspeak, old_len)
+                                : strndup(oldspeak, old_len); // copy it in oldspeak
         }
 
         /* do the same as above with newspeak */
         if (newspeak) {
             size_t new_len = strlen(newspeak);
-            n->newspeak = strndup(newspeak, new_len);
+            n->newspeak
+                = arena ? arena_strndup(arena, newspeak, new_len) : strndup(newspeak, new_len);
         }
 
-        /* could not allocate memory */
+        /* could not allocate memory (arena memory is freed with the arena) */
         if ((oldspeak && !n->oldspeak) || (newspeak && !n->newspeak)) {
-            free(n);
+            if (!arena) {
+                free(n->oldspeak);
+                free(n);
+            }
             n = NULL;
         }
     }
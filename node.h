@@ -1,6 +1,10 @@
 #ifndef __NODE_H__
 #define __NODE_H__
 
+#include "arena.h"
+
+#include <stdint.h>
+
 typedef struct Node Node;
 
 struct Node {
@@ -8,9 +12,11 @@ struct Node {
     char *newspeak;
     Node *next;
     Node *prev;
+    uint64_t hash; // hash of oldspeak (set by the hash table, used when it grows)
+    uint32_t length; // length of oldspeak (compared before the strings are)
 };
 
-Node *node_create(char *oldspeak, char *newspeak);
+Node *node_create(char *oldspeak, char *newspeak, Arena *arena);
 
 void node_delete(Node **n);
 
@@ -0,0 +1,435 @@
+#include "normalize.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * a Normalizer undoes the spellings that get words past the filter (b4d,
+ * baaaad, b.a.d): a table maps every byte to its canonical byte (4 to a, @
+ * to a, an uppercase letter to its lowercase) or drops it (.), and a run of
+ * the same ASCII byte is collapsed to one. the dictionary's words are indexed
+ * by their canonical form when they are loaded, so an obfuscated word of the
+ * input costs one pass over the table and one lookup of the index, instead of
+ * every spelling of every word being in the dictionary. a word spelled
+ * plainly (no byte mapped or dropped, no run of LONG_RUN) is never looked up
+ * by its form, so good is not god.
+ */
+
+#define NONE        0xFFFFFFFF // no form (out of memory)
+#define FIRST_SLOTS 64 // slots of the index to start with (a power of 2)
+#define FIRST_FORMS 64
+#define LONG_RUN    3 // a run of a letter this long is obfuscation (baaad), a shorter one is spelling (good)
+
+/* the substitutions used when no table is given (see normalizer_defaults) */
+static const char defaults[][2] = {
+    { '0', 'o' },
+    { '1', 'i' },
+    { '3', 'e' },
+    { '4', 'a' },
+    { '5', 's' },
+    { '7', 't' },
+    { '8', 'b' },
+    { '9', 'g' },
+    { '@', 'a' },
+    { '$', 's' },
+    { '!', 'i' },
+    { '|', 'l' },
+    { '+', 't' },
+    { '.', '\0' },
+    { '_', '\0' },
+};
+
+/* a canonical form and a dictionary word indexed by it: their offsets in the pool and lengths */
+typedef struct Form {
+    uint32_t at;
+    uint32_t length;
+    uint32_t word;
+    uint32_t word_length;
+    uint32_t next; // the next word with the same form (0 if none)
+} Form;
+
+/* a slot of the index (id 0 if the slot is empty) */
+typedef struct FormSlot {
+    uint32_t tag; // high bits of the form's hash
+    uint32_t id;
+} FormSlot;
+
+/* Normalizer definition */
+struct Normalizer {
+    uint8_t table[256]; // canonical byte of each byte (0 to drop it)
+    bool inner[256]; // punctuation the table maps or drops (it can be inside an obfuscated word)
+    bool kept[256]; // bytes the table keeps as they are (but for ASCII case)
+    FormSlot *slots; // the index (open addressing by the hash of the form)
+    uint32_t slot_count;
+    uint32_t slot_used; // different forms
+    Form *forms; // by id (from 1)
+    uint32_t form_count;
+    uint32_t form_cap;
+    char *pool; // the NUL terminated forms and words
+    uint32_t pool_used;
+    uint32_t pool_size;
+};
+
+/* helper function that resizes an array to hold count items of size bytes. returns false if out of memory */
+static bool reserve(void **array, uint32_t count, size_t size) {
+    void *grown = realloc(*array, (size_t) count * size);
+    if (!grown)
+        return false;
+    *array = grown;
+    return true;
+}
+
+/* helper function that lowercases an ASCII letter */
+static inline uint8_t lower(uint8_t c) {
+    return (uint8_t) (c + (((uint32_t) (c - 'A') < 26u) << 5));
+}
+
+/* helper function that checks if an ASCII byte is a word character of the scanner */
+static inline bool word_byte(uint8_t c) {
+    return (lower(c) >= 'a' && lower(c) <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* helper function that hashes a form (FNV-1a, forms are short) */
+static inline uint64_t form_hash(const char *form, uint32_t length) {
+    uint64_t h = 0xcbf29ce484222325;
+    for (uint32_t i = 0; i < length; i++)
+        h = (h ^ (uint8_t) form[i]) * 0x100000001b3;
+
+    /* murmur3's finalizer, so the low bits (the slot) depend on all of them */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    return h;
+}
+
+/* helper function that returns the slot of a form in the index: its own, or the empty one it would take */
+static uint32_t form_slot(Normalizer *z, const char *form, uint32_t length, uint64_t h) {
+    uint32_t mask = z->slot_count - 1, tag = (uint32_t) (h >> 32);
+
+    for (uint32_t i = (uint32_t) h & mask;; i = (i + 1) & mask) {
+        FormSlot *s = &(z->slots[i]);
+        if (!s->id)
+            return i;
+
+        Form *f = &(z->forms[s->id]);
+        if (s->tag == tag && f->length == length && !memcmp(z->pool + f->at, form, length))
+            return i;
+    }
+}
+
+/* helper function that copies length bytes (and a NUL) to the pool. returns their offset, NONE if out of memory */
+static uint32_t pool_add(Normalizer *z, const char *s, uint32_t length) {
+    if ((uint64_t) z->pool_used + length + 1 > UINT32_MAX)
+        return NONE;
+
+    if (z->pool_used + length + 1 > z->pool_size) {
+        uint32_t size = z->pool_size ? z->pool_size : 1024;
+        while (size < z->pool_used + length + 1)
+            size = size > UINT32_MAX / 2 ? UINT32_MAX : size * 2;
+        if (!reserve((void **) &(z->pool), size, sizeof(char)))
+            return NONE;
+        z->pool_size = size;
+    }
+
+    uint32_t at = z->pool_used;
+    memcpy(z->pool + at, s, length);
+    z->pool[at + length] = '\0';
+    z->pool_used += length + 1;
+    return at;
+}
+
+/* helper function that doubles the index. returns false if out of memory */
+static bool grow_slots(Normalizer *z) {
+    FormSlot *old = z->slots;
+    uint32_t old_count = z->slot_count;
+
+    z->slots = (FormSlot *) calloc((size_t) old_count * 2, sizeof(FormSlot));
+    if (!z->slots) {
+        z->slots = old;
+        return false;
+    }
+    z->slot_count = old_count * 2;
+
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (!old[i].id)
+            continue;
+        Form *f = &(z->forms[old[i].id]);
+        uint64_t h = form_hash(z->pool + f->at, f->length);
+        z->slots[form_slot(z, z->pool + f->at, f->length, h)] = old[i];
+    }
+
+    free(old);
+    return true;
+}
+
+/* constructor for a Normalizer that only lowercases ASCII letters (see normalizer_map) */
+Normalizer *normalizer_create(void) {
+    Normalizer *z = (Normalizer *) calloc(1, sizeof(Normalizer));
+    if (!z)
+        return NULL;
+
+    for (uint32_t c = 0; c < 256; c++) {
+        z->table[c] = lower((uint8_t) c);
+        z->kept[c] = c != 0;
+    }
+    z->table[0] = '\0'; // no word has one
+
+    z->slot_count = FIRST_SLOTS;
+    z->form_cap = FIRST_FORMS;
+    z->slots = (FormSlot *) calloc(z->slot_count, sizeof(FormSlot));
+    z->forms = (Form *) malloc(z->form_cap * sizeof(Form));
+
+    if (!z->slots || !z->forms)
+        normalizer_delete(&z);
+    return z;
+}
+
+/* destructor for a Normalizer */
+void normalizer_delete(Normalizer **z) {
+    if (z && *z) {
+        free((*z)->slots);
+        free((*z)->forms);
+        free((*z)->pool);
+        free(*z);
+        *z = NULL;
+    }
+    return;
+}
+
+/*
+ * maps the ASCII character from (either case of a letter) to to, or drops it
+ * if to is '\0'. both must be printable and not spaces. the words already
+ * indexed are not indexed again, so the table is set up first. returns false
+ * if the characters are not valid.
+ */
+bool normalizer_map(Normalizer *z, char from, char to) {
+    uint8_t f = (uint8_t) from, t = lower((uint8_t) to);
+    if (!z || f <= ' ' || f >= 0x7f || (t && (t <= ' ' || t >= 0x7f)))
+        return false;
+
+    f = lower(f);
+    z->table[f] = t;
+    z->kept[f] = t == f;
+    if (f >= 'a' && f <= 'z') {
+        z->table[f - 32] = t;
+        z->kept[f - 32] = t == f;
+    }
+    z->inner[f] = !word_byte(f) && t != f;
+    return true;
+}
+
+/* maps the usual substitutions: digits and symbols to the letters they look like, and drops . and _ (' and - are in plain words: it's, co-op) */
+void normalizer_defaults(Normalizer *z) {
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+        normalizer_map(z, defaults[i][0], defaults[i][1]);
+    return;
+}
+
+/*
+ * indexes the dictionary word oldspeak (length bytes, case folded) by its
+ * canonical form. words with the same form (god and good) are kept in the
+ * order they were added (see normalizer_lookup). returns false if out of memory.
+ */
+bool normalizer_add(Normalizer *z, const char *oldspeak, uint32_t length) {
+    if (!z || !oldspeak)
+        return false;
+
+    char *form = (char *) malloc(length + 1);
+    if (!form)
+        return false;
+
+    uint32_t n = normalizer_apply(z, form, oldspeak, length);
+    uint64_t h = form_hash(form, n);
+    uint32_t i = form_slot(z, form, n, h);
+
+    uint32_t first = z->slots[i].id, last = first;
+    while (last && z->forms[last].next)
+        last = z->forms[last].next;
+
+    bool ok = true;
+    if (n) {
+        if (z->form_count + 1 == z->form_cap) {
+            ok = reserve((void **) &(z->forms), z->form_cap * 2, sizeof(Form));
+            if (ok)
+                z->form_cap *= 2;
+        }
+
+        /* the form is in the pool once */
+        uint32_t at = !ok ? NONE : first ? z->forms[first].at : pool_add(z, form, n);
+        uint32_t word = at != NONE ? pool_add(z, oldspeak, length) : NONE;
+        ok = word != NONE;
+
+        if (ok) {
+            uint32_t id = ++z->form_count;
+            z->forms[id] = (Form) { at, n, word, length, 0 };
+            if (last)
+                z->forms[last].next = id;
+            else {
+                z->slots[i].tag = (uint32_t) (h >> 32);
+                z->slots[i].id = id;
+                z->slot_used++;
+            }
+
+            /* kept at most half full: most forms looked up are not there, and their probes stop at an empty slot */
+            if (z->slot_used * 2 >= z->slot_count)
+                ok = grow_slots(z);
+        }
+    }
+
+    free(form);
+    return ok;
+}
+
+/*
+ * writes the canonical form of src (length bytes) to dst (length bytes, it
+ * can be src): each byte through the table, dropped bytes left out and runs
+ * of the same ASCII byte collapsed to one. returns its length.
+ */
+uint32_t normalizer_apply(Normalizer *z, char *dst, const char *src, uint32_t length) {
+    uint32_t j = 0;
+    uint8_t last = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint8_t c = z->table[(uint8_t) src[i]];
+        if (!c || (c == last && c < 0x80))
+            continue;
+        dst[j++] = (char) c;
+        last = c;
+    }
+
+    return j;
+}
+
+/*
+ * checks if word (length bytes, case folded but for ASCII letters) is spelled
+ * plainly: no byte of it is mapped or dropped and no ASCII byte is repeated
+ * LONG_RUN times in a row. such a word is not obfuscated, whatever its form
+ * (good and god have the same one), so it is only looked up as it is.
+ */
+bool normalizer_plain(Normalizer *z, const char *word, uint32_t length) {
+    uint32_t run = 0;
+    uint8_t last = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t) word[i];
+        if (!z->kept[c])
+            return false;
+        run = z->table[c] == last && c < 0x80 ? run + 1 : 1;
+        if (run == LONG_RUN)
+            return false;
+        last = z->table[c];
+    }
+    return true;
+}
+
+/* helper function that reads the run of the same canonical byte at s[*i] (dropped bytes skipped). returns its length, 0 at the end */
+static uint32_t next_run(Normalizer *z, const char *s, uint32_t length, uint32_t *i, uint8_t *c) {
+    uint32_t run = 0;
+
+    for (; *i < length; (*i)++) {
+        uint8_t t = z->table[(uint8_t) s[*i]];
+        if (!t)
+            continue;
+        if (run && t != *c)
+            break;
+        *c = t;
+        run++;
+    }
+    return run;
+}
+
+/*
+ * helper function that compares the runs of word and spelled (of the same
+ * canonical form): returns 2 if they are the same, 1 if each run of word is
+ * at most as long as spelled's (good in goood), 0 otherwise.
+ */
+static uint32_t runs_fit(Normalizer *z, const char *word, uint32_t word_length, const char *spelled,
+    uint32_t spelled_length) {
+    uint32_t i = 0, j = 0, fit = 2;
+    uint8_t a = 0, b = 0;
+
+    for (;;) {
+        uint32_t ra = next_run(z, word, word_length, &i, &a);
+        uint32_t rb = next_run(z, spelled, spelled_length, &j, &b);
+        if (!ra || !rb)
+            return ra == rb ? fit : 0;
+        if (a != b || ra > rb)
+            return 0;
+        if (ra < rb)
+            fit = 1;
+    }
+}
+
+/* checks if c is punctuation the table maps or drops (so it can be part of an obfuscated word, e.g. sh!t) */
+bool normalizer_inner(Normalizer *z, char c) {
+    return z->inner[(uint8_t) c];
+}
+
+/* returns the table of the bytes normalizer_inner is true for (NULL if z is), to split text between obfuscated words */
+const bool *normalizer_joiners(Normalizer *z) {
+    return z ? z->inner : NULL;
+}
+
+/* checks if the table drops c */
+bool normalizer_drops(Normalizer *z, char c) {
+    return !z->table[(uint8_t) c];
+}
+
+/*
+ * returns the dictionary word indexed by the canonical form (length bytes) of
+ * spelled (spelled_length bytes, case folded), setting length_out to its
+ * length. of the words with that form, the one with the same runs as spelled
+ * is returned (g00d is good, not god), else the longest one whose runs fit in
+ * spelled's (goood is good too), else the first one added. returns NULL if
+ * no word has the form.
+ */
+const char *normalizer_lookup(Normalizer *z, const char *canonical, uint32_t length,
+    const char *spelled, uint32_t spelled_length, uint32_t *length_out) {
+    if (!z || !length)
+        return NULL;
+
+    uint32_t id = z->slots[form_slot(z, canonical, length, form_hash(canonical, length))].id;
+    if (!id)
+        return NULL;
+
+    if (z->forms[id].next) {
+        uint32_t best = 0;
+        for (uint32_t other = id; other; other = z->forms[other].next) {
+            Form *f = &(z->forms[other]);
+            uint32_t fit = runs_fit(z, z->pool + f->word, f->word_length, spelled, spelled_length);
+            if (fit == 2) {
+                best = other;
+                break;
+            }
+            if (fit && (!best || f->word_length > z->forms[best].word_length))
+                best = other;
+        }
+        id = best ? best : id;
+    }
+
+    *length_out = z->forms[id].word_length;
+    return z->pool + z->forms[id].word;
+}
+
+/* returns the number of different canonical forms indexed */
+uint32_t normalizer_count(Normalizer *z) {
+    return z ? z->slot_used : 0;
+}
+
+/* returns the number of ASCII characters the table maps to another one or drops (either case of a letter once) */
+uint32_t normalizer_rules(Normalizer *z) {
+    uint32_t rules = 0;
+    for (uint32_t c = 1; z && c < 0x80; c++)
+        rules += (c < 'A' || c > 'Z') && z->table[c] != c;
+    return rules;
+}
+
+/* returns the bytes the Normalizer holds (for stats) */
+size_t normalizer_bytes(Normalizer *z) {
+    if (!z)
+        return 0;
+    return sizeof(Normalizer) + (size_t) z->slot_count * sizeof(FormSlot)
+           + (size_t) z->form_cap * sizeof(Form) + z->pool_size;
+}
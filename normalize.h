@@ -0,0 +1,39 @@
+#ifndef __NORMALIZE_H__
+#define __NORMALIZE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Normalizer Normalizer;
+
+Normalizer *normalizer_create(void);
+
+void normalizer_delete(Normalizer **z);
+
+bool normalizer_map(Normalizer *z, char from, char to);
+
+void normalizer_defaults(Normalizer *z);
+
+bool normalizer_add(Normalizer *z, const char *oldspeak, uint32_t length);
+
+uint32_t normalizer_apply(Normalizer *z, char *dst, const char *src, uint32_t length);
+
+bool normalizer_plain(Normalizer *z, const char *word, uint32_t length);
+
+bool normalizer_inner(Normalizer *z, char c);
+
+const bool *normalizer_joiners(Normalizer *z);
+
+bool normalizer_drops(Normalizer *z, char c);
+
+const char *normalizer_lookup(Normalizer *z, const char *canonical, uint32_t length,
+    const char *spelled, uint32_t spelled_length, uint32_t *length_out);
+
+uint32_t normalizer_count(Normalizer *z);
+
+uint32_t normalizer_rules(Normalizer *z);
+
+size_t normalizer_bytes(Normalizer *z);
+
+#endif
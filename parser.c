@@ -1,83 +1,427 @@
 #include "parser.h"
 
-#include <regex.h>
+#include "unicode.h"
+
+#include <stdbool.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
-#define BLOCK 4096
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define LANE 16 // bytes classified per SIMD step
+#define INVALID 0xFFFFFFFF // code point of a byte that does not start valid UTF-8
+#define SPAN_BYTES 4096 // an obfuscated word is shorter than this (MAX_WORD, see filter.h)
+
+/*
+ * The tokenizer recognizes the same words as the regex the lab provided:
+ *
+ *     [a-zA-Z0-9_]+([-']?[a-zA-Z0-9_])*
+ *
+ * i.e. a run of word characters, optionally joined to further runs by a
+ * single - or ' that is directly followed by another word character.
+ * Leftmost-longest matching of that pattern is the same as scanning to the
+ * first word character and greedily extending the run across joiners.
+ *
+ * The input is UTF-8, and the word characters are those of the pattern plus
+ * every other letter, mark, decimal digit and connector of Unicode (see
+ * unicode.py, which generates their tables). runs of ASCII are classified 16
+ * bytes at a time, and only the bytes >= 0x80 they stop at are decoded.
+ * invalid UTF-8 never belongs to a word.
+ */
+
+/* lookup table: 1 if the byte is in [a-zA-Z0-9_], 0 otherwise */
+static const uint8_t word_char[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0x30 (0-9)
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40 (A-O)
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // 0x50 (P-Z, _)
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60 (a-o)
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, // 0x70 (p-z)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80 - 0xff are decoded
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // (see word_at)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/* helper function to check for the - and ' characters that can join runs */
+static inline bool is_joiner(char c) {
+    return c == '-' || c == '\'';
+}
+
+/*
+ * helper function that decodes the UTF-8 character at s (n > 0 bytes left)
+ * into cp. returns its length. overlong forms, surrogates and truncated or
+ * invalid sequences set cp to INVALID and have length 1.
+ */
+static inline uint32_t utf8_decode(const char *s, uint64_t n, uint32_t *cp) {
+    const uint8_t *u = (const uint8_t *) s;
+    uint32_t length, c = u[0];
+
+    *cp = INVALID;
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+        c &= 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        c &= 0x0F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        c &= 0x07;
+    } else
+        return 1;
+
+    if (n < length)
+        return 1;
+    for (uint32_t i = 1; i < length; i++) {
+        if ((u[i] & 0xC0) != 0x80)
+            return 1;
+        c = (c << 6) | (u[i] & 0x3F);
+    }
+
+    /* shortest form only, no surrogates, nothing past U+10FFFF */
+    if ((length == 3 && (c < 0x800 || (c >= 0xD800 && c < 0xE000)))
+        || (length == 4 && (c < 0x10000 || c > 0x10FFFF)))
+        return 1;
+
+    *cp = c;
+    return length;
+}
+
+/* helper function that encodes cp as UTF-8 at out. returns its length */
+static inline uint32_t utf8_encode(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char) cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char) (0xC0 | (cp >> 6));
+        out[1] = (char) (0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char) (0xE0 | (cp >> 12));
+        out[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char) (0xF0 | (cp >> 18));
+    out[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char) (0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* helper function that checks if a (non ASCII) code point is a word character */
+static inline bool unicode_word(uint32_t cp) {
+    if (cp < UNICODE_LIMIT) {
+        uint32_t i = (uint32_t) unicode_word_index[cp >> UNICODE_WORD_SHIFT] << UNICODE_WORD_SHIFT
+                     | (cp & ((1u << UNICODE_WORD_SHIFT) - 1));
+        return (unicode_word_bits[i / 8] >> (i % 8)) & 1;
+    }
+
+    /* past the tables: the CJK ideographs of planes 2 and 3, and variation selectors */
+    return cp < 0x40000 || (cp >= 0xE0100 && cp <= 0xE01EF);
+}
+
+/* helper function that returns the simple case folding of a code point */
+static inline uint32_t unicode_fold(uint32_t cp) {
+    if (cp >= UNICODE_LIMIT)
+        return cp;
+
+    uint32_t i = (uint32_t) unicode_fold_index[cp >> UNICODE_FOLD_SHIFT] << UNICODE_FOLD_SHIFT
+                 | (cp & ((1u << UNICODE_FOLD_SHIFT) - 1));
+    return (uint32_t) ((int32_t) cp + unicode_fold_delta[i]);
+}
+
+/*
+ * helper function that returns the length of the word character at s[i] (n
+ * bytes in the buffer), 0 if it is not one.
+ */
+static inline uint32_t word_at(const char *s, uint64_t i, uint64_t n) {
+    uint8_t c = (uint8_t) s[i];
+    if (c < 0x80)
+        return word_char[c];
+
+    uint32_t cp, length = utf8_decode(s + i, n - i, &cp);
+    return cp != INVALID && unicode_word(cp) ? length : 0;
+}
+
+#ifdef __SSE2__
+/* helper function that returns a bitmask of word characters in s[0..15] */
+static inline uint32_t word_mask(const char *s) {
+    __m128i v = _mm_loadu_si128((const __m128i *) s);
+
+    /* or-ing in 0x20 lowercases letters, so one range check covers both cases */
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+        _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+
+    /* bytes >= 0x80 are negative as signed chars so they fail every range above */
+    return (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+#endif
+
+#ifdef __SSE2__
+/* helper function that lowercases the bytes in [A-Z] of a lane (adds 0x20 to them) */
+static inline __m128i lower_lane(__m128i v) {
+    __m128i upper = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/*
+ * helper function that returns the first index in [i, n) whose byte is (or is
+ * not, if want_word is false) an ASCII word character, or is >= 0x80 (to be
+ * decoded by the caller). returns n if there is none.
+ */
+static inline uint64_t scan(const char *s, uint64_t i, uint64_t n, bool want_word) {
+#ifdef __SSE2__
+    while (i < n) {
+        uint32_t mask = word_mask(s + i);
+        if (!want_word)
+            mask = ~mask & 0xFFFF; // bytes >= 0x80 are not in word_mask, so they stop it too
+        else
+            mask |= (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + i)));
+
+        /* ignore the bytes past the end of the buffer */
+        if (n - i < LANE)
+            mask &= (1u << (n - i)) - 1;
+
+        if (mask)
+            return i + (uint32_t) __builtin_ctz(mask);
+
+        i += LANE;
+    }
+    return n;
+#else
+    while (i < n && (uint8_t) s[i] < 0x80 && word_char[(uint8_t) s[i]] != want_word)
+        i++;
+    return i;
+#endif
+}
 
-static char *words[BLOCK] = { NULL }; // Stores a block of words maximum.
+//
+// Starts a scan over the words of a buffer.
+//
+// w:           The scan state to set up.
+// text:        The buffer (WORDS_PADDING bytes past its end must be readable).
+// size:        Number of bytes in the buffer.
+//
+void words_init(Words *w, const char *text, uint64_t size) {
+    w->text = text;
+    w->size = size;
+    w->cursor = 0;
+    return;
+}
 
 //
-// Returns the next word that matches the specified regular expression.
-// Words are buffered and returned as they are read from the input file.
+// Returns the next word of a buffer.
+// Words are returned as views into the buffer (they are not NUL terminated).
 //
-// infile:      The input file to read from.
-// word_regex:  The compiled regular expression for a word.
+// w:           The scan state.
+// length:      Set to the length of the returned word (UINT32_MAX if longer).
 // returns:     The next word if it exists, a null pointer otherwise.
 //
-char *next_word(FILE *infile, regex_t *word_regex) {
-    static uint32_t index = 0; // Track the word to return.
-    static uint32_t count = 0; // How many words have we stored?
+const char *words_next(Words *w, uint32_t *length) {
+    const char *s = w->text;
+    uint64_t n = w->size;
 
-    if (!index) {
-        clear_words();
+    /* first word character (a byte >= 0x80 is decoded, and skipped if it is not one) */
+    uint64_t begin = w->cursor;
+    while (true) {
+        begin = scan(s, begin, n, true);
+        if (begin >= n) {
+            w->cursor = n;
+            return NULL;
+        }
+        if ((uint8_t) s[begin] < 0x80 || word_at(s, begin, n))
+            break;
 
-        regmatch_t match;
-        uint32_t matches = 0;
-        char buffer[BLOCK] = { 0 };
+        uint32_t cp;
+        begin += utf8_decode(s + begin, n - begin, &cp);
+    }
 
-        while (!matches) {
-            if (!fgets(buffer, BLOCK, infile)) {
-                return NULL;
-            }
+    /* extend the run over UTF-8 word characters and across single joiners followed by one */
+    uint64_t end = begin;
+    while (true) {
+        uint32_t bytes;
+        end = scan(s, end, n, false);
+        if (end < n && (uint8_t) s[end] >= 0x80 && (bytes = word_at(s, end, n)))
+            end += bytes;
+        else if (end + 1 < n && is_joiner(s[end]) && word_at(s, end + 1, n))
+            end += 1;
+        else
+            break;
+    }
 
-            char *cursor = buffer;
+    w->cursor = end;
 
-            for (uint16_t i = 0; i < BLOCK; i += 1) {
-                if (regexec(word_regex, cursor, 1, &match, 0)) {
-                    break; // Couldn't find a match.
-                }
+    if (length)
+        *length = end - begin < UINT32_MAX ? (uint32_t) (end - begin) : UINT32_MAX;
 
-                if (match.rm_so < 0) {
-                    break; // No more matches.
-                }
+    return s + begin;
+}
 
-                uint32_t start = (uint32_t) match.rm_so;
-                uint32_t end = (uint32_t) match.rm_eo;
-                uint32_t length = end - start;
+//
+// Copies a word, lowercasing [A-Z] on the way (16 or 32 bytes at a time).
+//
+// dst:         Where to copy the word to (length bytes, not NUL terminated).
+// src:         The word.
+// length:      Length of the word.
+//
+void words_lower(char *dst, const char *src, uint32_t length) {
+    uint32_t i = 0;
 
-                words[i] = (char *) calloc(length + 1, sizeof(char));
-                if (!words[i]) {
-                    perror("calloc");
-                    exit(1);
-                }
+#if defined(__AVX2__)
+    for (; i + 2 * LANE <= length; i += 2 * LANE) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+        v = _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+        _mm256_storeu_si256((__m256i *) (dst + i), v);
+    }
+#endif
 
-                memcpy(words[i], cursor + start, length);
-                cursor += end;
-                matches += 1;
-            }
+#ifdef __SSE2__
+    if (length >= LANE) {
+        for (; i + LANE <= length; i += LANE)
+            _mm_storeu_si128((__m128i *) (dst + i),
+                lower_lane(_mm_loadu_si128((const __m128i *) (src + i))));
 
-            count = matches; // Words stored is number of matches.
+        /* the last lane overlaps the one before it instead of running past the word */
+        if (i < length) {
+            i = length - LANE;
+            _mm_storeu_si128((__m128i *) (dst + i),
+                lower_lane(_mm_loadu_si128((const __m128i *) (src + i))));
+            i = length;
         }
     }
+#endif
+
+    for (; i < length; i++) {
+        uint8_t c = (uint8_t) src[i];
+        dst[i] = (char) ((c >= 'A' && c <= 'Z') ? c + 32 : c); // upper-lower diff = 32
+    }
+    return;
+}
+
+//
+// Checks if a word is all ASCII (8 bytes at a time), i.e. folding it is only
+// lowercasing it.
+//
+// s:           The word.
+// length:      Length of the word.
+// returns:     True if no byte of the word is >= 0x80.
+//
+bool words_ascii(const char *s, uint32_t length) {
+    uint64_t high = 0, chunk;
+    uint32_t i = 0;
 
-    char *word = words[index];
-    index = (index + 1) % count;
-    return word;
+    for (; i + 8 <= length; i += 8) {
+        memcpy(&chunk, s + i, 8);
+        high |= chunk;
+    }
+    for (; i < length; i++)
+        high |= (uint8_t) s[i];
+    return !(high & 0x8080808080808080ull);
 }
 
 //
-// Clears out the static word buffer.
+// Copies a word, applying Unicode simple case folding on the way. ASCII words
+// are lowercased by words_lower, and within the others lanes of ASCII are
+// still lowercased 16 bytes at a time. other characters are decoded,
+// folded through the generated tables and encoded again (invalid UTF-8 is
+// copied as it is).
 //
-void clear_words(void) {
-    for (uint16_t i = 0; i < BLOCK; i += 1) {
-        if (words[i]) {
-            free(words[i]);
-            words[i] = NULL;
+// dst:         Where to copy the word to (not NUL terminated). Folding can
+//              make a word longer, so it must hold WORDS_FOLDED(length) bytes.
+// src:         The word.
+// length:      Length of the word.
+// returns:     The length of the folded word.
+//
+uint32_t words_fold(char *dst, const char *src, uint32_t length) {
+    uint32_t i = 0, j = 0;
+
+    if (words_ascii(src, length)) {
+        words_lower(dst, src, length);
+        return length;
+    }
+
+    while (i < length) {
+#ifdef __SSE2__
+        if (length - i >= LANE) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+            if (!_mm_movemask_epi8(v)) {
+                _mm_storeu_si128((__m128i *) (dst + j), lower_lane(v));
+                i += LANE;
+                j += LANE;
+                continue;
+            }
         }
+#endif
+
+        uint8_t c = (uint8_t) src[i];
+        if (c < 0x80) {
+            dst[j++] = (char) ((c >= 'A' && c <= 'Z') ? c + 32 : c);
+            i++;
+            continue;
+        }
+
+        uint32_t cp, n = utf8_decode(src + i, length - i, &cp);
+        if (cp == INVALID)
+            dst[j++] = src[i];
+        else
+            j += utf8_encode(unicode_fold(cp), dst + j);
+        i += n;
     }
 
-    return;
+    return j;
+}
+
+//
+// Finds where a buffer can be split without changing its words.
+//
+// text:        The buffer.
+// size:        Number of bytes in the buffer.
+// inner:       The ASCII bytes that also join words into one obfuscated word
+//              (b.a.d, see normalizer_joiners), NULL if none.
+// returns:     The largest p < size such that scanning text[0, p) and then
+//              text[p, ...) gives the same words (and obfuscated words) as
+//              scanning it whole, 0 if there is none.
+//
+uint64_t words_split(const char *text, uint64_t size, const bool *inner) {
+
+    /* not inside an obfuscated word either: never at a byte inner joins with (unless none is near the end) */
+    for (uint64_t p = size; inner && p-- > 1 && size - p <= SPAN_BYTES;) {
+        uint8_t c = (uint8_t) text[p];
+        if (c < 0x80 && !word_char[c] && !is_joiner((char) c) && !inner[c])
+            return p;
+    }
+
+    /* a word never continues into an ASCII byte that is neither a word character nor a joiner */
+    for (uint64_t p = size; p-- > 1;) {
+        uint8_t c = (uint8_t) text[p];
+        if (c < 0x80 && !word_char[c] && !is_joiner((char) c))
+            return p;
+    }
+    return 0;
 }
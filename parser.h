@@ -1,22 +1,81 @@
 #ifndef __PARSER_H__
 #define __PARSER_H__
 
-#include <regex.h>
-#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
 
+/* bytes that must be readable past the end of a buffer given to words_init */
+#define WORDS_PADDING 16
+
+/* most bytes a word of length bytes can take once folded (see words_fold) */
+#define WORDS_FOLDED(length) ((length) + (length) / 2 + 1)
+
+/* state of a scan over the words of an in-memory buffer (see words_next) */
+typedef struct Words {
+    const char *text; // the buffer
+    uint64_t size; // bytes in the buffer
+    uint64_t cursor; // where to resume scanning
+} Words;
+
+//
+// Starts a scan over the words of a buffer.
+//
+// w:           The scan state to set up.
+// text:        The buffer (WORDS_PADDING bytes past its end must be readable).
+// size:        Number of bytes in the buffer.
 //
-// Returns the next word that matches the specified regular expression.
-// Words are buffered and returned as they are read from the input file.
+void words_init(Words *w, const char *text, uint64_t size);
+
+//
+// Returns the next word of a buffer (UTF-8, see parser.c for what a word is).
+// Words are returned as views into the buffer (they are not NUL terminated).
 //
-// infile:      The input file to read from.
-// word_regex:  The compiled regular expression for a word.
+// w:           The scan state.
+// length:      Set to the length of the returned word (UINT32_MAX if longer).
 // returns:     The next word if it exists, a null pointer otherwise.
 //
-char *next_word(FILE *infile, regex_t *word_regex);
+const char *words_next(Words *w, uint32_t *length);
+
+//
+// Copies a word, lowercasing [A-Z] on the way (16 or 32 bytes at a time).
+//
+// dst:         Where to copy the word to (length bytes, not NUL terminated).
+// src:         The word.
+// length:      Length of the word.
+//
+void words_lower(char *dst, const char *src, uint32_t length);
+
+//
+// Checks if a word is all ASCII (so folding it is only lowercasing it).
+//
+// s:           The word.
+// length:      Length of the word.
+// returns:     True if no byte of the word is >= 0x80.
+//
+bool words_ascii(const char *s, uint32_t length);
 
 //
-// Clears out the static word buffer.
+// Copies a word, applying Unicode simple case folding (UTF-8 in and out).
+//
+// dst:         Where to copy the word to (WORDS_FOLDED(length) bytes, not NUL
+//              terminated).
+// src:         The word.
+// length:      Length of the word.
+// returns:     The length of the folded word.
+//
+uint32_t words_fold(char *dst, const char *src, uint32_t length);
+
+//
+// Finds where a buffer can be split without changing its words.
+//
+// text:        The buffer.
+// size:        Number of bytes in the buffer.
+// inner:       The ASCII bytes that also join words into one obfuscated word
+//              (b.a.d, see normalizer_joiners), NULL if none.
+// returns:     The largest p < size such that scanning text[0, p) and then
+//              text[p, ...) gives the same words (and obfuscated words) as
+//              scanning it whole, 0 if there is none.
 //
-void clear_words(void);
+uint64_t words_split(const char *text, uint64_t size, const bool *inner);
 
 #endif
@@ -0,0 +1,545 @@
+#include "phrases.h"
+
+#include "filter.h"
+#include "parser.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Phrases are dictionary entries of several words ("double plus ungood").
+ * they are matched with an Aho-Corasick automaton whose alphabet is not bytes
+ * but the words of the phrases: each of them is numbered (a token, 0 being
+ * any other word), and the phrases are a trie over their tokens. every state
+ * has a failure link to the longest proper suffix of its path that is also a
+ * path, so the input is read once, word by word, whatever the number of
+ * phrases: a step looks the word's token up in a small hash table, then
+ * follows at most as many failure links as the steps that went deeper before
+ * (linear in the words overall). the root's edges are in a table by token,
+ * since most steps start or end there, and a state without edges goes
+ * straight to its failure state.
+ */
+
+#define NONE         0xFFFFFFFF // no state, phrase or newspeak
+#define FIRST_SLOTS  64 // slots of the token and edge tables to start with (powers of 2)
+#define FIRST_STATES 64
+
+/* a word of the phrases: its offset in the pool and its length */
+typedef struct Token {
+    uint32_t at;
+    uint32_t length;
+} Token;
+
+/* a slot of the token table (id 0 if the slot is empty) */
+typedef struct TokenSlot {
+    uint32_t tag; // high bits of the word's hash
+    uint32_t id;
+} TokenSlot;
+
+/* an edge of the trie, from state on token to next (next 0 if the slot is empty: the root is no target) */
+typedef struct Edge {
+    uint32_t state;
+    uint32_t token;
+    uint32_t next;
+} Edge;
+
+/* a state of the trie */
+typedef struct State {
+    uint32_t phrase; // the phrase ending at this state (NONE if none)
+    uint32_t parent;
+    uint32_t token; // of the edge from the parent
+    uint32_t depth; // words on the path
+    uint32_t children; // edges from the state
+} State;
+
+/* what a step needs of a state, once the phrases are built (see phrases_build) */
+typedef struct Link {
+    uint32_t fail; // state of the longest proper suffix of the path that is a path
+    uint32_t report; // nearest state ending a phrase, this one or along the failure links (NONE if none)
+    uint32_t children;
+} Link;
+
+/* a phrase: offsets of its text (the folded words, one space apart) and newspeak in the pool */
+typedef struct Phrase {
+    uint32_t text;
+    uint32_t newspeak; // NONE for badspeak
+} Phrase;
+
+/* Phrases definition */
+struct Phrases {
+    TokenSlot *slots; // token table (open addressing by the hash of the word)
+    uint32_t slot_count;
+    Token *tokens; // by id (from 1)
+    uint32_t token_count;
+    uint32_t token_cap;
+    Edge *edges; // edge table (open addressing by state and token)
+    uint32_t edge_slots;
+    uint32_t edge_count;
+    State *states; // the root is state 0
+    uint32_t state_count;
+    uint32_t state_cap;
+    Link *links; // by state (NULL until built)
+    uint32_t *root; // target of the root's edge on each token (0 if none)
+    Phrase *phrases;
+    uint32_t count;
+    uint32_t phrase_cap;
+    uint32_t longest; // words of the longest phrase
+    char *pool; // the NUL terminated tokens, texts and newspeak
+    uint32_t pool_used;
+    uint32_t pool_size;
+};
+
+/* helper function that resizes an array to hold count items of size bytes. returns false if out of memory */
+static bool reserve(void **array, uint32_t count, size_t size) {
+    void *grown = realloc(*array, (size_t) count * size);
+    if (!grown)
+        return false;
+    *array = grown;
+    return true;
+}
+
+/* helper function that lowercases an ASCII letter (the other bytes of a word are folded already) */
+static inline uint8_t lower(char c) {
+    uint8_t u = (uint8_t) c;
+    return (uint8_t) (u + (((uint32_t) (u - 'A') < 26u) << 5));
+}
+
+/* helper function that hashes a word as if it were lowercased (FNV-1a, words are short) */
+static inline uint64_t word_hash(const char *word, uint32_t length) {
+    uint64_t h = 0xcbf29ce484222325;
+    for (uint32_t i = 0; i < length; i++)
+        h = (h ^ lower(word[i])) * 0x100000001b3;
+
+    /* murmur3's finalizer, so the low bits (the slot) depend on all of them */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    return h;
+}
+
+/* helper function that hashes an edge by its state and token */
+static inline uint32_t edge_hash(uint32_t state, uint32_t token) {
+    uint64_t h = ((uint64_t) state << 32 | token) * 0x9e3779b97f4a7c15;
+    return (uint32_t) (h >> 32);
+}
+
+/* helper function that returns the slot of word in the token table: its own, or the empty one it would take */
+static uint32_t token_slot(Phrases *p, const char *word, uint32_t length, uint64_t h) {
+    uint32_t mask = p->slot_count - 1, tag = (uint32_t) (h >> 32);
+
+    for (uint32_t i = (uint32_t) h & mask;; i = (i + 1) & mask) {
+        TokenSlot *s = &(p->slots[i]);
+        if (!s->id)
+            return i;
+
+        Token *t = &(p->tokens[s->id]);
+        if (s->tag != tag || t->length != length)
+            continue;
+
+        uint32_t k = 0;
+        const char *known = p->pool + t->at;
+        while (k < length && lower(word[k]) == (uint8_t) known[k])
+            k++;
+        if (k == length)
+            return i;
+    }
+}
+
+/* helper function that returns the target of the edge from state on token (0 if there is none) */
+static inline uint32_t edge_next(Phrases *p, uint32_t state, uint32_t token) {
+    uint32_t mask = p->edge_slots - 1;
+
+    for (uint32_t i = edge_hash(state, token) & mask;; i = (i + 1) & mask) {
+        Edge *e = &(p->edges[i]);
+        if (!e->next || (e->state == state && e->token == token))
+            return e->next;
+    }
+}
+
+/* helper function that copies length bytes (and a NUL) to the pool. returns their offset, NONE if out of memory */
+static uint32_t pool_add(Phrases *p, const char *s, uint32_t length) {
+    if ((uint64_t) p->pool_used + length + 1 > UINT32_MAX)
+        return NONE;
+
+    if (p->pool_used + length + 1 > p->pool_size) {
+        uint32_t size = p->pool_size ? p->pool_size : 1024;
+        while (size < p->pool_used + length + 1)
+            size = size > UINT32_MAX / 2 ? UINT32_MAX : size * 2;
+        if (!reserve((void **) &(p->pool), size, sizeof(char)))
+            return NONE;
+        p->pool_size = size;
+    }
+
+    uint32_t at = p->pool_used;
+    memcpy(p->pool + at, s, length);
+    p->pool[at + length] = '\0';
+    p->pool_used += length + 1;
+    return at;
+}
+
+/* helper function that doubles the token table. returns false if out of memory */
+static bool grow_tokens(Phrases *p) {
+    TokenSlot *old = p->slots;
+    uint32_t old_count = p->slot_count;
+
+    p->slots = (TokenSlot *) calloc((size_t) old_count * 2, sizeof(TokenSlot));
+    if (!p->slots) {
+        p->slots = old;
+        return false;
+    }
+    p->slot_count = old_count * 2;
+
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (!old[i].id)
+            continue;
+        Token *t = &(p->tokens[old[i].id]);
+        uint64_t h = word_hash(p->pool + t->at, t->length);
+        p->slots[token_slot(p, p->pool + t->at, t->length, h)] = old[i];
+    }
+
+    free(old);
+    return true;
+}
+
+/* helper function that returns the token of a folded word, numbering it if it is new (0 if out of memory) */
+static uint32_t token_of(Phrases *p, const char *word, uint32_t length) {
+    uint64_t h = word_hash(word, length);
+    uint32_t i = token_slot(p, word, length, h);
+    if (p->slots[i].id)
+        return p->slots[i].id;
+
+    if (p->token_count + 1 == p->token_cap) {
+        if (!reserve((void **) &(p->tokens), p->token_cap * 2, sizeof(Token)))
+            return 0;
+        p->token_cap *= 2;
+    }
+
+    uint32_t at = pool_add(p, word, length);
+    if (at == NONE)
+        return 0;
+
+    uint32_t id = ++p->token_count;
+    p->tokens[id].at = at;
+    p->tokens[id].length = length;
+    p->slots[i].tag = (uint32_t) (h >> 32);
+    p->slots[i].id = id;
+
+    /* kept at most a quarter full: most words of the input are in no phrase, and their probes stop at an empty slot */
+    if (p->token_count * 4 >= p->slot_count && !grow_tokens(p))
+        return 0;
+    return id;
+}
+
+/* helper function that doubles the edge table. returns false if out of memory */
+static bool grow_edges(Phrases *p) {
+    Edge *old = p->edges;
+    uint32_t old_slots = p->edge_slots;
+
+    p->edges = (Edge *) calloc((size_t) old_slots * 2, sizeof(Edge));
+    if (!p->edges) {
+        p->edges = old;
+        return false;
+    }
+    p->edge_slots = old_slots * 2;
+
+    uint32_t mask = p->edge_slots - 1;
+    for (uint32_t i = 0; i < old_slots; i++) {
+        if (!old[i].next)
+            continue;
+        uint32_t k = edge_hash(old[i].state, old[i].token) & mask;
+        while (p->edges[k].next)
+            k = (k + 1) & mask;
+        p->edges[k] = old[i];
+    }
+
+    free(old);
+    return true;
+}
+
+/* helper function that returns the child of state on token, adding it if there is none (0 if out of memory) */
+static uint32_t child_of(Phrases *p, uint32_t state, uint32_t token) {
+    uint32_t next = edge_next(p, state, token);
+    if (next)
+        return next;
+
+    if (p->state_count == p->state_cap) {
+        if (!reserve((void **) &(p->states), p->state_cap * 2, sizeof(State)))
+            return 0;
+        p->state_cap *= 2;
+    }
+
+    next = p->state_count++;
+    State *s = &(p->states[next]);
+    s->phrase = NONE;
+    s->parent = state;
+    s->token = token;
+    s->depth = p->states[state].depth + 1;
+    s->children = 0;
+    p->states[state].children++;
+
+    uint32_t mask = p->edge_slots - 1, k = edge_hash(state, token) & mask;
+    while (p->edges[k].next)
+        k = (k + 1) & mask;
+    p->edges[k].state = state;
+    p->edges[k].token = token;
+    p->edges[k].next = next;
+
+    /* kept at most half full */
+    if (++p->edge_count * 2 >= p->edge_slots && !grow_edges(p))
+        return 0;
+    return next;
+}
+
+/* constructor for Phrases (with none yet) */
+Phrases *phrases_create(void) {
+    Phrases *p = (Phrases *) calloc(1, sizeof(Phrases));
+    if (!p)
+        return NULL;
+
+    p->slot_count = p->edge_slots = FIRST_SLOTS;
+    p->token_cap = p->state_cap = p->phrase_cap = FIRST_STATES;
+    p->slots = (TokenSlot *) calloc(p->slot_count, sizeof(TokenSlot));
+    p->tokens = (Token *) malloc(p->token_cap * sizeof(Token));
+    p->edges = (Edge *) calloc(p->edge_slots, sizeof(Edge));
+    p->states = (State *) malloc(p->state_cap * sizeof(State));
+    p->phrases = (Phrase *) malloc(p->phrase_cap * sizeof(Phrase));
+
+    if (!p->slots || !p->tokens || !p->edges || !p->states || !p->phrases) {
+        phrases_delete(&p);
+        return NULL;
+    }
+
+    /* the root, where every phrase starts (and any other word goes back to) */
+    State *root = &(p->states[PHRASES_START]);
+    root->phrase = NONE;
+    root->parent = PHRASES_START;
+    root->token = root->depth = root->children = 0;
+    p->state_count = 1;
+
+    return p;
+}
+
+/* destructor for Phrases */
+void phrases_delete(Phrases **p) {
+    if (p && *p) {
+        free((*p)->slots);
+        free((*p)->tokens);
+        free((*p)->edges);
+        free((*p)->states);
+        free((*p)->links);
+        free((*p)->root);
+        free((*p)->phrases);
+        free((*p)->pool);
+        free(*p);
+        *p = NULL;
+    }
+    return;
+}
+
+/*
+ * adds the phrase whose words are in text (length bytes, WORDS_PADDING
+ * readable past them) to Phrases, with its newspeak (NULL for badspeak). the
+ * words are scanned and case folded like the input's. a phrase that is there
+ * already keeps its newspeak, and one with a word as long as MAX_WORD (which
+ * the input never matches) is skipped. returns false if out of memory.
+ */
+bool phrases_add(Phrases *p, const char *text, uint32_t length, const char *newspeak) {
+    if (!p || !text)
+        return false;
+
+    /* room for the folded words, one space apart (see WORDS_FOLDED) */
+    char *folded = (char *) malloc(3 * (size_t) length + 2);
+    if (!folded)
+        return false;
+
+    Words w;
+    const char *view;
+    uint32_t size, used = 0, words = 0, state = PHRASES_START;
+    bool ok = true;
+
+    words_init(&w, text, length);
+    while (ok && (view = words_next(&w, &size)) != NULL) {
+        if (size >= MAX_WORD) {
+            free(folded);
+            return true;
+        }
+
+        char *word = folded + used;
+        size = words_fold(word, view, size);
+        uint32_t token = token_of(p, word, size);
+        state = token ? child_of(p, state, token) : 0;
+        ok = state != 0;
+
+        used += size;
+        folded[used++] = ' ';
+        words++;
+    }
+
+    if (ok && words && p->states[state].phrase == NONE) {
+        if (p->count == p->phrase_cap) {
+            ok = reserve((void **) &(p->phrases), p->phrase_cap * 2, sizeof(Phrase));
+            p->phrase_cap *= ok ? 2 : 1;
+        }
+
+        uint32_t at = ok ? pool_add(p, folded, used - 1) : NONE;
+        uint32_t translation = at != NONE && newspeak
+                                   ? pool_add(p, newspeak, (uint32_t) strlen(newspeak))
+                                   : NONE;
+        ok = at != NONE && (!newspeak || translation != NONE);
+
+        if (ok) {
+            p->phrases[p->count].text = at;
+            p->phrases[p->count].newspeak = translation;
+            p->states[state].phrase = p->count++;
+            p->longest = words > p->longest ? words : p->longest;
+        }
+    }
+
+    free(folded);
+    return ok;
+}
+
+/*
+ * links every state of Phrases to its failure state, once all the phrases are
+ * added (and again if more are). the states are linked by depth, so the state
+ * a failure link goes to (which is shallower) is always linked already.
+ * returns false if out of memory.
+ */
+bool phrases_build(Phrases *p) {
+    if (!p)
+        return false;
+
+    uint32_t n = p->state_count, deepest = 0;
+    for (uint32_t s = 0; s < n; s++) // (states of skipped phrases can be deeper than the longest)
+        deepest = p->states[s].depth > deepest ? p->states[s].depth : deepest;
+
+    uint32_t *first = (uint32_t *) calloc(deepest + 2, sizeof(uint32_t));
+    uint32_t *order = (uint32_t *) malloc(n * sizeof(uint32_t));
+    bool ok = first && order && reserve((void **) &(p->links), n, sizeof(Link))
+              && reserve((void **) &(p->root), p->token_count + 1, sizeof(uint32_t));
+    if (!ok) {
+        free(order);
+        free(first);
+        return false;
+    }
+
+    /* the states by depth (counting sort) */
+    for (uint32_t s = 0; s < n; s++)
+        first[p->states[s].depth + 1]++;
+    for (uint32_t d = 0; d <= deepest; d++)
+        first[d + 1] += first[d];
+    for (uint32_t s = 0; s < n; s++)
+        order[first[p->states[s].depth]++] = s;
+
+    memset(p->root, 0, (p->token_count + 1) * sizeof(uint32_t));
+    p->links[PHRASES_START].fail = PHRASES_START;
+    p->links[PHRASES_START].report = NONE;
+    p->links[PHRASES_START].children = p->states[PHRASES_START].children;
+
+    for (uint32_t i = 1; i < n; i++) { // order[0] is the root
+        uint32_t v = order[i];
+        State *s = &(p->states[v]);
+
+        /* the longest suffix of the parent's path that goes on with the same token */
+        uint32_t f = PHRASES_START;
+        if (s->parent == PHRASES_START)
+            p->root[s->token] = v;
+        else {
+            f = p->links[s->parent].fail;
+            while (f != PHRASES_START && !edge_next(p, f, s->token))
+                f = p->links[f].fail;
+            f = f == PHRASES_START ? p->root[s->token] : edge_next(p, f, s->token);
+        }
+
+        p->links[v].fail = f;
+        p->links[v].report = s->phrase != NONE ? v : p->links[f].report;
+        p->links[v].children = s->children;
+    }
+
+    free(order);
+    free(first);
+    return true;
+}
+
+/*
+ * returns the token of word (length bytes, folded but for its ASCII letters,
+ * which are lowercased here): 0 if no phrase has the word.
+ */
+uint32_t phrases_token(Phrases *p, const char *word, uint32_t length) {
+    return p->slots[token_slot(p, word, length, word_hash(word, length))].id;
+}
+
+/*
+ * moves state (of built Phrases) past a word with token. returns the state
+ * if a phrase ends there (see phrases_output), PHRASES_START if none does.
+ */
+uint32_t phrases_next(Phrases *p, uint32_t *state, uint32_t token) {
+    uint32_t s = *state, next = 0;
+
+    /* a word no phrase has goes back to the root */
+    while (token) {
+        if (s == PHRASES_START) {
+            next = p->root[token];
+            break;
+        }
+
+        Link *l = &(p->links[s]);
+        if (l->children && (next = edge_next(p, s, token)) != 0)
+            break;
+        s = l->fail;
+    }
+
+    *state = next;
+    return p->links[next].report == NONE ? PHRASES_START : next;
+}
+
+/*
+ * finds the next phrase that ends at state: at it or along its failure links,
+ * longest first. sets old_out and new_out to its text and newspeak (NULL for
+ * badspeak), and state to where to look for the one after. returns false if
+ * there is none left.
+ */
+bool phrases_output(Phrases *p, uint32_t *state, const char **old_out, const char **new_out) {
+    uint32_t s = p->links[*state].report;
+    if (s == NONE)
+        return false;
+
+    Phrase *ph = &(p->phrases[p->states[s].phrase]);
+    *old_out = p->pool + ph->text;
+    *new_out = ph->newspeak == NONE ? NULL : p->pool + ph->newspeak;
+    *state = p->links[s].fail;
+    return true;
+}
+
+/* returns the number of phrases */
+uint32_t phrases_count(Phrases *p) {
+    return p ? p->count : 0;
+}
+
+/* returns the words of the longest phrase */
+uint32_t phrases_longest(Phrases *p) {
+    return p ? p->longest : 0;
+}
+
+/* returns the number of different words in the phrases */
+uint32_t phrases_tokens(Phrases *p) {
+    return p ? p->token_count : 0;
+}
+
+/* returns the number of states of the automaton */
+uint32_t phrases_states(Phrases *p) {
+    return p ? p->state_count : 0;
+}
+
+/* returns the bytes the Phrases hold (for stats) */
+size_t phrases_bytes(Phrases *p) {
+    if (!p)
+        return 0;
+    return sizeof(Phrases) + (size_t) p->slot_count * sizeof(TokenSlot)
+           + (size_t) p->token_cap * sizeof(Token) + (size_t) p->edge_slots * sizeof(Edge)
+           + (size_t) p->state_cap * sizeof(State) + (size_t) p->phrase_cap * sizeof(Phrase)
+           + (p->links ? (size_t) p->state_count * sizeof(Link) : 0)
+           + (p->root ? (size_t) (p->token_count + 1) * sizeof(uint32_t) : 0) + p->pool_size;
+}
@@ -0,0 +1,37 @@
+#ifndef __PHRASES_H__
+#define __PHRASES_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* state of the phrases before any word (or after a word no phrase has) */
+#define PHRASES_START 0
+
+typedef struct Phrases Phrases;
+
+Phrases *phrases_create(void);
+
+void phrases_delete(Phrases **p);
+
+bool phrases_add(Phrases *p, const char *text, uint32_t length, const char *newspeak);
+
+bool phrases_build(Phrases *p);
+
+uint32_t phrases_token(Phrases *p, const char *word, uint32_t length);
+
+uint32_t phrases_next(Phrases *p, uint32_t *state, uint32_t token);
+
+bool phrases_output(Phrases *p, uint32_t *state, const char **old_out, const char **new_out);
+
+uint32_t phrases_count(Phrases *p);
+
+uint32_t phrases_longest(Phrases *p);
+
+uint32_t phrases_tokens(Phrases *p);
+
+uint32_t phrases_states(Phrases *p);
+
+size_t phrases_bytes(Phrases *p);
+
+#endif
@@ -0,0 +1,274 @@
+#include "record.h"
+
+#include "parser.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Records split the input into small documents that are filtered one at a
+ * time: lines, NUL terminated strings, or JSON lines whose text is one string
+ * field. like Words, records are views into the buffer, and the text of a
+ * JSON line is only copied when it has escapes to decode.
+ */
+
+/* parses the name of a record format (line, nul or jsonl). returns false if unknown */
+bool record_format(const char *name, RecordFormat *format) {
+    if (!name || !format)
+        return false;
+
+    if (!strcmp(name, "line"))
+        *format = RECORD_LINE;
+    else if (!strcmp(name, "nul"))
+        *format = RECORD_NUL;
+    else if (!strcmp(name, "jsonl"))
+        *format = RECORD_JSONL;
+    else
+        return false;
+    return true;
+}
+
+/* returns the byte that ends a record of the format */
+char record_delimiter(RecordFormat format) {
+    return format == RECORD_NUL ? '\0' : '\n';
+}
+
+/* starts a scan over the records of a buffer (the last one need not be delimited) */
+void records_init(Records *r, const char *text, uint64_t size, char delimiter) {
+    r->text = text;
+    r->size = size;
+    r->cursor = 0;
+    r->delimiter = delimiter;
+    return;
+}
+
+/* returns the next record (without its delimiter) and sets size to its length. NULL at the end */
+const char *records_next(Records *r, uint64_t *size) {
+    if (r->cursor >= r->size)
+        return NULL;
+
+    const char *begin = r->text + r->cursor;
+    const char *end = (const char *) memchr(begin, r->delimiter, r->size - r->cursor);
+    uint64_t length = end ? (uint64_t) (end - begin) : r->size - r->cursor;
+
+    r->cursor += length + (end != NULL);
+    *size = length;
+    return begin;
+}
+
+/* helper function that returns the index of the first byte from i that is not JSON whitespace */
+static uint64_t skip_space(const char *s, uint64_t i, uint64_t n) {
+    while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n'))
+        i++;
+    return i;
+}
+
+/*
+ * helper function that skips the string whose opening quote is at i. returns
+ * the index past its closing quote (0 if there is none) and sets escaped if
+ * the string has escapes.
+ */
+static uint64_t skip_string(const char *s, uint64_t i, uint64_t n, bool *escaped) {
+    for (i++; i < n; i++) {
+        if (s[i] == '"')
+            return i + 1;
+        if (s[i] == '\\') {
+            *escaped = true;
+            i++;
+        }
+    }
+    return 0;
+}
+
+/* helper function that skips the JSON value at i (nested ones included). returns the index past it */
+static uint64_t skip_value(const char *s, uint64_t i, uint64_t n) {
+    bool escaped = false;
+    uint32_t depth = 0;
+
+    while (i < n) {
+        char c = s[i];
+        if (c == '"') {
+            i = skip_string(s, i, n, &escaped);
+            if (!i)
+                return n;
+        } else if (c == '{' || c == '[') {
+            depth++;
+            i++;
+        } else if (c == '}' || c == ']') {
+            if (!depth)
+                return i; // ends the enclosing object
+            depth--;
+            i++;
+        } else if (c == ',' && !depth)
+            return i;
+        else
+            i++;
+
+        if (!depth && (c == '"' || c == '}' || c == ']'))
+            return i;
+    }
+    return n;
+}
+
+/* helper function that returns the value of a hex digit (-1 if it is not one) */
+static int hex(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* helper function that reads the 4 hex digits of a \u escape at s[i]. returns -1 if invalid */
+static int32_t code_unit(const char *s, uint64_t i, uint64_t n) {
+    if (i + 4 > n)
+        return -1;
+
+    int32_t u = 0;
+    for (uint64_t k = i; k < i + 4; k++) {
+        int h = hex(s[k]);
+        if (h < 0)
+            return -1;
+        u = u * 16 + h;
+    }
+    return u;
+}
+
+/* helper function that writes code point cp as UTF-8 at out. returns the bytes written */
+static uint64_t utf8(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char) cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char) (0xC0 | (cp >> 6));
+        out[1] = (char) (0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char) (0xE0 | (cp >> 12));
+        out[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char) (0xF0 | (cp >> 18));
+    out[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char) (0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * helper function that decodes the n bytes of a JSON string's contents into
+ * out (never longer than n). invalid escapes are kept as they are. returns
+ * the length of the decoded string.
+ */
+static uint64_t decode(const char *s, uint64_t n, char *out) {
+    uint64_t length = 0;
+
+    for (uint64_t i = 0; i < n; i++) {
+        if (s[i] != '\\' || i + 1 == n) {
+            out[length++] = s[i];
+            continue;
+        }
+
+        char c = s[++i];
+        switch (c) {
+        case 'b': out[length++] = '\b'; break;
+        case 'f': out[length++] = '\f'; break;
+        case 'n': out[length++] = '\n'; break;
+        case 'r': out[length++] = '\r'; break;
+        case 't': out[length++] = '\t'; break;
+        case 'u': {
+            int32_t u = code_unit(s, i + 1, n);
+            if (u < 0) {
+                out[length++] = '\\';
+                out[length++] = c;
+                break;
+            }
+            i += 4;
+
+            /* a high surrogate and its low surrogate make one code point */
+            uint32_t cp = (uint32_t) u;
+            if (u >= 0xD800 && u < 0xDC00 && i + 2 < n && s[i + 1] == '\\' && s[i + 2] == 'u') {
+                int32_t low = code_unit(s, i + 3, n);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + (((uint32_t) u - 0xD800) << 10) + ((uint32_t) low - 0xDC00);
+                    i += 6;
+                }
+            }
+            length += utf8(cp, out + length);
+            break;
+        }
+        default: out[length++] = c; break; // \" \\ \/
+        }
+    }
+
+    return length;
+}
+
+/*
+ * returns the text of field (a string) in the JSON object of a line (size
+ * bytes) and sets length to its length. it points into the line if the string
+ * has no escapes, otherwise it is decoded into buffer, which must hold size +
+ * WORDS_PADDING bytes. like a buffer given to words_init, WORDS_PADDING bytes
+ * past the text are readable. returns NULL if the line is not an object with
+ * such a field.
+ */
+const char *record_json_text(
+    const char *line, uint64_t size, const char *field, char *buffer, uint64_t *length) {
+    if (!line || !field || !buffer || !length)
+        return NULL;
+
+    uint64_t n = size, name = strlen(field);
+    uint64_t i = skip_space(line, 0, n);
+    if (i >= n || line[i] != '{')
+        return NULL;
+
+    i = skip_space(line, i + 1, n);
+    while (i < n && line[i] == '"') {
+        bool escaped = false;
+
+        /* the key (compared as it is written) */
+        uint64_t key = i + 1;
+        i = skip_string(line, i, n, &escaped);
+        if (!i)
+            return NULL;
+        bool match = !escaped && i - key - 1 == name && !memcmp(line + key, field, name);
+
+        i = skip_space(line, i, n);
+        if (i >= n || line[i] != ':')
+            return NULL;
+        i = skip_space(line, i + 1, n);
+        if (i >= n)
+            return NULL;
+
+        /* the value: the text if it is the field's string */
+        if (match && line[i] == '"') {
+            uint64_t begin = i + 1;
+            escaped = false;
+            uint64_t end = skip_string(line, i, n, &escaped);
+            if (!end)
+                return NULL; // unterminated
+
+            uint64_t count = end - 1 - begin;
+            if (!escaped) {
+                *length = count;
+                return line + begin;
+            }
+
+            *length = decode(line + begin, count, buffer);
+            memset(buffer + *length, 0, WORDS_PADDING);
+            return buffer;
+        }
+
+        i = skip_space(line, skip_value(line, i, n), n);
+        if (i < n && line[i] == ',')
+            i = skip_space(line, i + 1, n);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,29 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* how the input is split into records (see -R) */
+typedef enum RecordFormat { RECORD_LINE, RECORD_NUL, RECORD_JSONL } RecordFormat;
+
+/* state of a scan over the records of an in-memory buffer (see records_next) */
+typedef struct Records {
+    const char *text; // the buffer
+    uint64_t size; // bytes in the buffer
+    uint64_t cursor; // where the next record starts
+    char delimiter; // what ends a record
+} Records;
+
+bool record_format(const char *name, RecordFormat *format);
+
+char record_delimiter(RecordFormat format);
+
+void records_init(Records *r, const char *text, uint64_t size, char delimiter);
+
+const char *records_next(Records *r, uint64_t *size);
+
+const char *record_json_text(
+    const char *line, uint64_t size, const char *field, char *buffer, uint64_t *length);
+
+#endif
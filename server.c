@@ -0,0 +1,361 @@
+#include "server.h"
+
+#include "collector.h"
+#include "dict.h"
+#include "filter.h"
+#include "parser.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * The daemon loads the dictionary once and serves requests (see server.h)
+ * with a pool of worker threads. every worker accepts connections on the
+ * shared listening socket itself and serves one connection at a time with
+ * its own Filter, so the only state the workers share is the (read only)
+ * dictionary. clients past the number of workers wait in the listen backlog
+ * until a worker is free.
+ */
+
+#define REPLY_HEADER 5 // length and verdict bytes that start a response
+
+/* Server definition */
+typedef struct Server {
+    Dict *dict; // shared, only read
+    int listener; // the listening socket
+    pthread_mutex_t lock; // guards stop and clients
+    bool stop; // set when the daemon is told to exit
+    int *clients; // connection each worker is serving (-1 if none)
+} Server;
+
+/* a worker thread and everything it owns */
+typedef struct Worker {
+    Server *server;
+    uint32_t id; // index in server->clients
+    Filter *filter;
+    Stats stats; // counters of every request it served
+    char *text; // the request being served
+    uint64_t capacity; // bytes text can hold (plus WORDS_PADDING)
+    char *reply; // the response being built
+    size_t reply_size;
+    size_t reply_capacity;
+} Worker;
+
+/* writes size bytes of data to fd. returns false if the connection is gone */
+bool server_send(int fd, const void *data, size_t size) {
+    const char *p = (const char *) data;
+
+    while (size) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL); // no SIGPIPE if the peer left
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= (size_t) n;
+    }
+
+    return true;
+}
+
+/* reads exactly size bytes from fd into data. returns false at eof or on error */
+bool server_recv(int fd, void *data, size_t size) {
+    char *p = (char *) data;
+
+    while (size) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= (size_t) n;
+    }
+
+    return true;
+}
+
+/* helper function that appends size bytes of data to the response */
+static bool reply_append(Worker *w, const char *data, size_t size) {
+    if (w->reply_size + size > w->reply_capacity) {
+        size_t capacity = w->reply_capacity ? w->reply_capacity : 4096;
+        while (capacity < w->reply_size + size)
+            capacity *= 2;
+
+        char *reply = (char *) realloc(w->reply, capacity);
+        if (!reply)
+            return false;
+
+        w->reply = reply;
+        w->reply_capacity = capacity;
+    }
+
+    memcpy(w->reply + w->reply_size, data, size);
+    w->reply_size += size;
+    return true;
+}
+
+/* helper function that appends the transgressions in c to the response */
+static bool reply_matches(Worker *w, Collector *c) {
+    Match *m;
+
+    for (uint32_t i = 0; (m = collector_get(c, i)) != NULL; i++) {
+        if (!reply_append(w, m->oldspeak, strlen(m->oldspeak)))
+            return false;
+        if (m->newspeak
+            && (!reply_append(w, "->", 2) || !reply_append(w, m->newspeak, strlen(m->newspeak))))
+            return false;
+        if (!reply_append(w, "\n", 1))
+            return false;
+    }
+
+    return true;
+}
+
+/* helper function that sends an error response (the connection is closed after it) */
+static void reply_error(int fd, const char *message) {
+    size_t size = strlen(message);
+    uint8_t header[REPLY_HEADER];
+
+    server_pack(header, (uint32_t) size + 1);
+    header[4] = SERVER_ERROR;
+    if (server_send(fd, header, REPLY_HEADER))
+        server_send(fd, message, size);
+}
+
+/* helper function that serves the requests of a connection until it is closed */
+static void serve(Worker *w, int fd) {
+    static const char blank[REPLY_HEADER] = { 0 }; // filled in once the response is built
+    uint8_t header[4];
+
+    while (server_recv(fd, header, sizeof(header))) {
+        uint32_t size = server_unpack(header);
+
+        if (size > SERVER_MAX_TEXT) {
+            reply_error(fd, "Request too large.");
+            return;
+        }
+
+        /* room for the text and the padding the word scanner reads past it */
+        if (size > w->capacity || !w->text) {
+            char *text = (char *) realloc(w->text, (size_t) size + WORDS_PADDING);
+            if (!text) {
+                reply_error(fd, "Out of memory.");
+                return;
+            }
+            w->text = text;
+            w->capacity = size;
+        }
+
+        if (!server_recv(fd, w->text, size))
+            return;
+        memset(w->text + size, 0, WORDS_PADDING);
+
+        /* the whole request is one text, so it ends between words */
+        bool ok = filter_text(w->filter, w->text, size);
+        stats_add(&(w->stats), filter_stats(w->filter));
+
+        Collector *bad = filter_badspeak(w->filter);
+        Collector *right = filter_rightspeak(w->filter);
+
+        uint8_t verdict = (collector_count(bad) ? SERVER_THOUGHTCRIME : 0)
+                          | (collector_count(right) ? SERVER_RIGHTCRIME : 0);
+
+        /* length and verdict first, then the transgressions */
+        w->reply_size = 0;
+        ok = ok && reply_append(w, blank, REPLY_HEADER) && reply_matches(w, bad)
+             && reply_matches(w, right);
+        filter_reset(w->filter);
+
+        if (!ok) {
+            reply_error(fd, "Out of memory.");
+            return;
+        }
+
+        server_pack((uint8_t *) w->reply, (uint32_t) (w->reply_size - 4));
+        w->reply[4] = (char) verdict;
+
+        if (!server_send(fd, w->reply, w->reply_size))
+            return;
+    }
+}
+
+/* helper function that records the connection a worker serves. false if the daemon is stopping */
+static bool enter(Server *s, uint32_t id, int fd) {
+    pthread_mutex_lock(&(s->lock));
+    bool stop = s->stop;
+    if (!stop)
+        s->clients[id] = fd;
+    pthread_mutex_unlock(&(s->lock));
+    return !stop;
+}
+
+/* helper function that forgets the connection a worker served */
+static void leave(Server *s, uint32_t id) {
+    pthread_mutex_lock(&(s->lock));
+    s->clients[id] = -1;
+    pthread_mutex_unlock(&(s->lock));
+}
+
+/* helper function that checks if the daemon is stopping */
+static bool stopping(Server *s) {
+    pthread_mutex_lock(&(s->lock));
+    bool stop = s->stop;
+    pthread_mutex_unlock(&(s->lock));
+    return stop;
+}
+
+/* thread function of a worker: accepts and serves connections until the daemon stops */
+static void *worker_run(void *arg) {
+    Worker *w = (Worker *) arg;
+    Server *s = w->server;
+
+    while (true) {
+        int fd = accept(s->listener, NULL, NULL);
+
+        if (fd < 0) {
+            int error = errno;
+            if (stopping(s))
+                break;
+            if (error != EINTR && error != ECONNABORTED)
+                poll(NULL, 0, 10); // out of fds or memory, try again shortly
+            continue;
+        }
+
+        if (!enter(s, w->id, fd)) {
+            close(fd);
+            break;
+        }
+
+        serve(w, fd);
+        leave(s, w->id);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+/* helper function that makes the listening socket at path */
+static int listen_on(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+
+    /* replace the socket of a previous run, but never any other file */
+    if (!lstat(path, &st)) {
+        if (!S_ISSOCK(st.st_mode) || unlink(path))
+            return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * serves requests on the Unix domain socket at path with workers threads
+ * until SIGINT or SIGTERM, then removes the socket. the counters of every
+ * request served are added to stats. returns false if the socket or the
+ * workers could not be set up.
+ */
+bool server_run(Dict *dict, const char *path, uint32_t workers, Stats *stats) {
+    if (!dict || !path || !workers)
+        return false;
+
+    /* the signals are only taken by sigwait below (threads inherit the mask) */
+    sigset_t signals, old;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old);
+
+    Server s;
+    s.dict = dict;
+    s.stop = false;
+    s.listener = listen_on(path);
+    s.clients = (int *) malloc(workers * sizeof(int));
+    pthread_mutex_init(&(s.lock), NULL);
+
+    Worker *w = (Worker *) calloc(workers, sizeof(Worker));
+    pthread_t *threads = (pthread_t *) malloc(workers * sizeof(pthread_t));
+    uint32_t started = 0;
+
+    /* start the workers (as many as possible) */
+    if (s.listener >= 0 && s.clients && w && threads) {
+        for (uint32_t i = 0; i < workers; i++) {
+            s.clients[i] = -1;
+            w[i].server = &s;
+            w[i].id = i;
+            w[i].filter = filter_create(dict);
+            if (!w[i].filter || pthread_create(&threads[started], NULL, worker_run, &w[i])) {
+                filter_delete(&(w[i].filter));
+                break;
+            }
+            started++;
+        }
+    }
+
+    /* wait to be told to exit */
+    if (started) {
+        int sig;
+        sigwait(&signals, &sig);
+    }
+
+    /* wake the workers: blocked accepts and reads return */
+    pthread_mutex_lock(&(s.lock));
+    s.stop = true;
+    for (uint32_t i = 0; i < started; i++) {
+        if (s.clients[i] >= 0)
+            shutdown(s.clients[i], SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&(s.lock));
+
+    if (s.listener >= 0)
+        shutdown(s.listener, SHUT_RDWR);
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (stats)
+            stats_add(stats, &(w[i].stats));
+        filter_delete(&(w[i].filter));
+        free(w[i].text);
+        free(w[i].reply);
+    }
+
+    if (s.listener >= 0) {
+        close(s.listener);
+        unlink(path);
+    }
+
+    pthread_mutex_destroy(&(s.lock));
+    free(threads);
+    free(w);
+    free(s.clients);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    return started > 0;
+}
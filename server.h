@@ -0,0 +1,50 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "dict.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Protocol of the filter daemon (banhammer -u). a client connects to the Unix
+ * domain socket and sends any number of requests, each answered in order
+ * before the next one is read:
+ *
+ *   request:   4 byte length n (big endian), then n bytes of text to filter.
+ *   response:  4 byte length n (big endian), then n bytes: a verdict byte
+ *              (SERVER_* bits below) followed by the transgressions, one per
+ *              line in the order they were first seen: the badspeak words,
+ *              then the oldspeak words as "oldspeak->newspeak". if the
+ *              SERVER_ERROR bit is set the rest is an error message and the
+ *              connection is closed.
+ */
+
+#define SERVER_THOUGHTCRIME 0x01 // badspeak words were used
+#define SERVER_RIGHTCRIME   0x02 // oldspeak words were used
+#define SERVER_ERROR        0x80 // the request was not filtered
+
+#define SERVER_MAX_TEXT (64u << 20) // largest request accepted
+
+/* writes n into the 4 byte big endian length that starts a request or response */
+static inline void server_pack(uint8_t b[4], uint32_t n) {
+    b[0] = (uint8_t) (n >> 24);
+    b[1] = (uint8_t) (n >> 16);
+    b[2] = (uint8_t) (n >> 8);
+    b[3] = (uint8_t) n;
+}
+
+/* reads the 4 byte big endian length that starts a request or response */
+static inline uint32_t server_unpack(const uint8_t b[4]) {
+    return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+}
+
+bool server_run(Dict *dict, const char *path, uint32_t workers, Stats *stats);
+
+bool server_send(int fd, const void *data, size_t size);
+
+bool server_recv(int fd, void *data, size_t size);
+
+#endif
@@ -0,0 +1,412 @@
+#include "snapshot.h"
+
+#include "bf.h"
+#include "hash.h"
+#include "ht.h"
+#include "stats.h"
+#include "node.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * A snapshot is the built dictionary saved as one file that is mapped read
+ * only, so starting up does not depend on the size of the dictionary. Every
+ * reference inside the file is an offset from its start (position
+ * independent) and every section starts on a 64 byte boundary:
+ *
+ *   Header   magic, version, hash backend and salt, section offsets
+ *   bits     the Bloom filter bits exactly as bf_data returns them
+ *   index    capacity Index slots (linear probing on the word's hash)
+ *   entries  one Entry per word
+ *   pool     the NUL terminated oldspeak and newspeak strings
+ */
+
+#define MAGIC     "BANHAMMR"
+#define VERSION   1 // bump when the layout changes
+#define ENDIAN    0x01020304 // reads back differently on a machine of the other byte order
+#define ALIGNMENT 64
+#define NONE      UINT32_MAX // new_off of a word without newspeak
+
+typedef struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t backend; // HashBackend the digests were made with
+    uint32_t blocked; // Bloom filter layout
+    uint64_t salt[2]; // salt of the Hasher
+    uint32_t bf_size; // Bloom filter size in bits
+    uint32_t bf_count; // Bloom filter bits set
+    uint32_t entries; // words
+    uint32_t capacity; // index slots (a power of 2)
+    uint64_t bf_offset;
+    uint64_t bf_bytes;
+    uint64_t index_offset;
+    uint64_t entry_offset;
+    uint64_t pool_offset;
+    uint64_t pool_bytes;
+    uint64_t file_size;
+} Header;
+
+/* index slot: top 32 bits of the word's hash and its entry + 1 (0 if the slot is empty) */
+typedef struct Index {
+    uint32_t tag;
+    uint32_t entry;
+} Index;
+
+/* a word: its hash and where its strings are in the pool */
+typedef struct Entry {
+    uint64_t hash;
+    uint32_t old_off;
+    uint32_t old_len;
+    uint32_t new_off;
+    uint32_t new_len;
+} Entry;
+
+/* Snapshot definition (the mapped file) */
+struct Snapshot {
+    uint8_t *map; // start of the mapping
+    size_t length; // bytes mapped
+    const Header *header;
+    const Index *index;
+    const Entry *entries;
+    const char *pool;
+    BloomFilter *bf; // wraps the mapped bits
+};
+
+/* nodes of the HT collected for writing */
+typedef struct Nodes {
+    Node **nodes;
+    uint32_t count;
+    uint32_t size;
+    bool failed; // ran out of memory
+} Nodes;
+
+/* helper function that rounds n up to the next multiple of ALIGNMENT */
+static inline uint64_t align_up(uint64_t n) {
+    return (n + ALIGNMENT - 1) & ~((uint64_t) ALIGNMENT - 1);
+}
+
+/* helper function for ht_foreach: adds a node to the Nodes array */
+static void collect(Node *n, void *arg) {
+    Nodes *all = (Nodes *) arg;
+
+    if (all->count == all->size) {
+        uint32_t size = all->size ? all->size * 2 : 1024;
+        Node **nodes = (Node **) realloc(all->nodes, size * sizeof(Node *));
+        if (!nodes) {
+            all->failed = true;
+            return;
+        }
+        all->nodes = nodes;
+        all->size = size;
+    }
+
+    all->nodes[all->count++] = n;
+    return;
+}
+
+/* helper function that writes n bytes of data (or zeros if data is NULL) */
+static bool write_bytes(FILE *outfile, const void *data, uint64_t n) {
+    static const char zeros[ALIGNMENT] = { 0 };
+
+    if (data)
+        return fwrite(data, 1, n, outfile) == n;
+
+    for (; n; n -= n < ALIGNMENT ? n : ALIGNMENT) {
+        if (!fwrite(zeros, n < ALIGNMENT ? n : ALIGNMENT, 1, outfile))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * writes the dictionary in bf and ht to a snapshot at path. digests of the
+ * words must have been computed with backend and salt. the file is written
+ * next to path and renamed over it, so readers never see half a snapshot.
+ */
+bool snapshot_write(
+    const char *path, BloomFilter *bf, HashTable *ht, HashBackend backend, uint64_t *salt) {
+    if (!path || !bf || !ht || !salt)
+        return false;
+
+    Nodes all = { NULL, 0, 0, false };
+    ht_foreach(ht, collect, &all);
+
+    Header h;
+    memset(&h, 0, sizeof(Header));
+    memcpy(h.magic, MAGIC, sizeof(h.magic));
+    h.version = VERSION;
+    h.endian = ENDIAN;
+    h.backend = (uint32_t) backend;
+    h.blocked = bf_blocked(bf);
+    h.salt[0] = salt[0];
+    h.salt[1] = salt[1];
+    h.bf_size = bf_size(bf);
+    h.bf_count = bf_count(bf);
+    h.entries = all.count;
+
+    /* index at most half full so probe sequences stay short */
+    h.capacity = 16;
+    while (h.capacity < 2 * (uint64_t) all.count)
+        h.capacity <<= 1;
+
+    uint32_t bf_bytes = 0;
+    void *bits = bf_data(bf, &bf_bytes);
+
+    Index *index = (Index *) calloc(h.capacity, sizeof(Index));
+    Entry *entries = (Entry *) calloc(all.count ? all.count : 1, sizeof(Entry));
+
+    /* lay out the strings of each word in the pool and hash it into the index */
+    uint64_t pool = 0;
+    for (uint32_t i = 0; index && entries && i < all.count; i++) {
+        Node *n = all.nodes[i];
+        Entry *e = &(entries[i]);
+
+        e->hash = n->hash;
+        e->old_off = (uint32_t) pool;
+        e->old_len = n->length;
+        pool += e->old_len + 1;
+
+        e->new_off = NONE;
+        e->new_len = 0;
+        if (n->newspeak) {
+            e->new_off = (uint32_t) pool;
+            e->new_len = (uint32_t) strlen(n->newspeak);
+            pool += e->new_len + 1;
+        }
+
+        uint32_t pos = (uint32_t) n->hash & (h.capacity - 1);
+        while (index[pos].entry)
+            pos = (pos + 1) & (h.capacity - 1);
+        index[pos].tag = (uint32_t) (n->hash >> 32);
+        index[pos].entry = i + 1;
+    }
+
+    h.bf_offset = align_up(sizeof(Header));
+    h.bf_bytes = bf_bytes;
+    h.index_offset = align_up(h.bf_offset + h.bf_bytes);
+    h.entry_offset = align_up(h.index_offset + (uint64_t) h.capacity * sizeof(Index));
+    h.pool_offset = align_up(h.entry_offset + (uint64_t) h.entries * sizeof(Entry));
+    h.pool_bytes = pool;
+    h.file_size = h.pool_offset + h.pool_bytes;
+
+    /* the pool is addressed with 32 bit offsets */
+    bool ok = !all.failed && index && entries && bits && pool < UINT32_MAX;
+
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp = (char *) malloc(tmp_len);
+    FILE *outfile = NULL;
+    if (ok && tmp) {
+        snprintf(tmp, tmp_len, "%s.tmp", path);
+        outfile = fopen(tmp, "wb");
+    }
+
+    ok = ok && outfile;
+    ok = ok && write_bytes(outfile, &h, sizeof(Header));
+    ok = ok && write_bytes(outfile, NULL, h.bf_offset - sizeof(Header));
+    ok = ok && write_bytes(outfile, bits, h.bf_bytes);
+    ok = ok && write_bytes(outfile, NULL, h.index_offset - h.bf_offset - h.bf_bytes);
+    ok = ok && write_bytes(outfile, index, (uint64_t) h.capacity * sizeof(Index));
+    ok = ok
+         && write_bytes(outfile, NULL,
+             h.entry_offset - h.index_offset - (uint64_t) h.capacity * sizeof(Index));
+    ok = ok && write_bytes(outfile, entries, (uint64_t) h.entries * sizeof(Entry));
+    ok = ok
+         && write_bytes(outfile, NULL,
+             h.pool_offset - h.entry_offset - (uint64_t) h.entries * sizeof(Entry));
+
+    /* the strings, in the order the entries point at them */
+    for (uint32_t i = 0; ok && i < all.count; i++) {
+        Node *n = all.nodes[i];
+        ok = write_bytes(outfile, n->oldspeak, entries[i].old_len + 1);
+        if (ok && n->newspeak)
+            ok = write_bytes(outfile, n->newspeak, entries[i].new_len + 1);
+    }
+
+    if (outfile && fclose(outfile))
+        ok = false;
+    if (tmp && outfile && (!ok || rename(tmp, path)))
+        remove(tmp);
+
+    free(tmp);
+    free(index);
+    free(entries);
+    free(all.nodes);
+
+    return ok;
+}
+
+/* helper function that checks that a section lies inside the file */
+static inline bool in_file(const Header *h, uint64_t offset, uint64_t bytes) {
+    return offset <= h->file_size && bytes <= h->file_size - offset;
+}
+
+/* helper function that checks the header of a mapped snapshot of length bytes */
+static bool header_valid(const Header *h, size_t length) {
+    if (length < sizeof(Header) || memcmp(h->magic, MAGIC, sizeof(h->magic)))
+        return false;
+
+    if (h->version != VERSION || h->endian != ENDIAN || h->file_size != length)
+        return false;
+
+    if (h->backend >= NUM_BACKENDS || !h->bf_size || !h->capacity
+        || (h->capacity & (h->capacity - 1)) || h->entries > h->capacity)
+        return false;
+
+    /* the bits must be exactly what a BF of that size and layout holds */
+    uint64_t bf_bytes = h->blocked ? h->bf_size / 8 : h->bf_size / 8 + 1;
+    if (h->bf_bytes != bf_bytes || (h->blocked && (h->bf_size % 512 || h->bf_offset % ALIGNMENT)))
+        return false;
+
+    if (!in_file(h, h->bf_offset, h->bf_bytes)
+        || !in_file(h, h->index_offset, (uint64_t) h->capacity * sizeof(Index))
+        || !in_file(h, h->entry_offset, (uint64_t) h->entries * sizeof(Entry))
+        || !in_file(h, h->pool_offset, h->pool_bytes) || h->index_offset % ALIGNMENT
+        || h->entry_offset % ALIGNMENT)
+        return false;
+
+    /* the pool ends with a NUL, so no string read from it runs past the file */
+    return !h->pool_bytes || ((const char *) h)[h->pool_offset + h->pool_bytes - 1] == '\0';
+}
+
+/* maps the snapshot at path. returns NULL if it cannot be read or is not a valid snapshot */
+Snapshot *snapshot_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(Header)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (map == MAP_FAILED)
+        return NULL;
+
+    Snapshot *s = (Snapshot *) malloc(sizeof(Snapshot));
+    const Header *h = (const Header *) map;
+
+    if (!s || !header_valid(h, (size_t) st.st_size)) {
+        munmap(map, (size_t) st.st_size);
+        free(s);
+        return NULL;
+    }
+
+    s->map = (uint8_t *) map;
+    s->length = (size_t) st.st_size;
+    s->header = h;
+    s->index = (const Index *) (s->map + h->index_offset);
+    s->entries = (const Entry *) (s->map + h->entry_offset);
+    s->pool = (const char *) (s->map + h->pool_offset);
+    s->bf = bf_wrap(s->map + h->bf_offset, h->bf_size, h->bf_count, h->blocked);
+
+    if (!s->bf) {
+        snapshot_close(&s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/* unmaps a snapshot */
+void snapshot_close(Snapshot **s) {
+    if (s && *s) {
+        bf_delete(&((*s)->bf));
+        munmap((*s)->map, (*s)->length);
+        free(*s);
+        *s = NULL;
+    }
+    return;
+}
+
+/* returns the Bloom filter of the snapshot (read only) */
+BloomFilter *snapshot_bf(Snapshot *s) {
+    return s ? s->bf : NULL;
+}
+
+/* returns the hash backend the snapshot's digests were made with */
+HashBackend snapshot_backend(Snapshot *s) {
+    return s ? (HashBackend) s->header->backend : SPECK;
+}
+
+/* returns the salt the snapshot's digests were made with */
+uint64_t *snapshot_salt(Snapshot *s) {
+    return s ? (uint64_t *) s->header->salt : NULL;
+}
+
+/* returns the number of words in the snapshot */
+uint32_t snapshot_entries(Snapshot *s) {
+    return s ? s->header->entries : 0;
+}
+
+/* returns the number of index slots of the snapshot */
+uint32_t snapshot_size(Snapshot *s) {
+    return s ? s->header->capacity : 0;
+}
+
+/* returns the bytes mapped (the whole file, for stats) */
+size_t snapshot_bytes(Snapshot *s) {
+    return s ? s->length : 0;
+}
+
+/* starts loading the index slot of the word with digest d into the cache */
+void snapshot_prefetch(Snapshot *s, Digest *d) {
+    if (!s || !d)
+        return;
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+    __builtin_prefetch(&(s->index[(uint32_t) h & (s->header->capacity - 1)]));
+    return;
+}
+
+/*
+ * looks up oldspeak (length bytes, digest d). if found, sets old_out and
+ * new_out to its strings in the snapshot (new_out is NULL for badspeak).
+ * the seek and the slots it takes are counted in stats (if not NULL)
+ */
+bool snapshot_lookup(Snapshot *s, Digest *d, const char *oldspeak, uint32_t length,
+    const char **old_out, const char **new_out, Stats *stats) {
+    if (!s || !d || !oldspeak)
+        return false;
+
+    if (stats)
+        stats->seeks++;
+
+    uint64_t h = digest_index(d, DIGEST_HT_PROBE);
+    uint32_t mask = s->header->capacity - 1, pos = (uint32_t) h & mask;
+    uint32_t tag = (uint32_t) (h >> 32);
+
+    for (uint32_t probes = 0; probes <= mask; probes++, pos = (pos + 1) & mask) {
+        Index ix = s->index[pos];
+        if (!ix.entry || ix.entry > s->header->entries)
+            return false; // an empty slot ends the probe sequence
+
+        if (ix.tag == tag) {
+            const Entry *e = &(s->entries[ix.entry - 1]);
+            bool translated = e->new_off != NONE;
+            if (e->old_len == length && (uint64_t) e->old_off + length < s->header->pool_bytes
+                && (!translated || (uint64_t) e->new_off + e->new_len < s->header->pool_bytes)
+                && !memcmp(s->pool + e->old_off, oldspeak, length)) {
+                *old_out = s->pool + e->old_off;
+                *new_out = translated ? s->pool + e->new_off : NULL;
+                return true;
+            }
+        }
+
+        if (stats)
+            stats->links++; // moved on to the next slot
+    }
+
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "bf.h"
+#include "hash.h"
+#include "ht.h"
+#include "stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Snapshot Snapshot;
+
+bool snapshot_write(const char *path, BloomFilter *bf, HashTable *ht, HashBackend backend,
+    uint64_t *salt);
+
+Snapshot *snapshot_open(const char *path);
+
+void snapshot_close(Snapshot **s);
+
+BloomFilter *snapshot_bf(Snapshot *s);
+
+HashBackend snapshot_backend(Snapshot *s);
+
+uint64_t *snapshot_salt(Snapshot *s);
+
+uint32_t snapshot_entries(Snapshot *s);
+
+uint32_t snapshot_size(Snapshot *s);
+
+size_t snapshot_bytes(Snapshot *s);
+
+void snapshot_prefetch(Snapshot *s, Digest *d);
+
+bool snapshot_lookup(Snapshot *s, Digest *d, const char *oldspeak, uint32_t length,
+    const char **old_out, const char **new_out, Stats *stats);
+
+#endif
@@ -1,7 +1,6 @@
 #include "speck.h"
 
 #include <stddef.h>
-#include <string.h>
 
 // Ray Beaulieu, Stefan Treatman-Clark, Douglas Shors, Bryan Weeks, Jason
 // Smith and Louis Wingers. "The SIMON and SPECK lightweight block ciphers,"
@@ -14,19 +13,29 @@
 // Core SPECK operation
 #define R(x, y, k) (x = RCS(x, 8), x += y, x ^= k, y = LCS(y, 3), y ^= x)
 
-void speck_expand_key_and_encrypt(uint64_t pt[], uint64_t ct[], uint64_t K[]) {
+// Expands the 128 bit key K into the SPECK_ROUNDS round keys rk. The schedule
+// only depends on the key, so it is computed once per salt and reused for
+// every block instead of being rebuilt for each one.
+void speck_expand_key(uint64_t K[], uint64_t rk[]) {
     uint64_t B = K[1], A = K[0];
+
+    for (size_t i = 0; i < SPECK_ROUNDS; i += 1) {
+        rk[i] = A;
+        R(B, A, i);
+    }
+}
+
+static inline void speck_encrypt(const uint64_t pt[], uint64_t ct[], const uint64_t rk[]) {
     ct[0] = pt[0];
     ct[1] = pt[1];
 
-    for (size_t i = 0; i < 32; i += 1) {
-        R(ct[1], ct[0], A);
-        R(B, A, i);
+    for (size_t i = 0; i < SPECK_ROUNDS; i += 1) {
+        R(ct[1], ct[0], rk[i]);
     }
 }
 
-static uint64_t keyed_hash(const char *s, uint32_t length, uint64_t key[]) {
-    uint64_t accum = 0;
+Digest speck_hash(const uint64_t rk[], const char *s, uint32_t length) {
+    Digest accum = { 0, 0 };
 
     union {
         char b[2 * sizeof(uint64_t)]; // 16 bytes fit into the same space as
@@ -44,8 +53,9 @@ static uint64_t keyed_hash(const char *s, uint32_t length, uint64_t key[]) {
         in.b[count++] = s[i]; // Load the bytes
 
         if (count % (2 * sizeof(uint64_t)) == 0) {
-            speck_expand_key_and_encrypt(in.ll, out, key); // Encrypt 16 bytes
-            accum ^= out[0] ^ out[1]; // Add (XOR) them in for a 64 bit result
+            speck_encrypt(in.ll, out, rk); // Encrypt 16 bytes
+            accum.lo ^= out[0]; // Add (XOR) them in for a 128 bit result
+            accum.hi ^= out[1];
             count = 0; // Reset buffer counter
             in.ll[0] = 0x0;
             in.ll[1] = 0x0; // Reset the input buffer
@@ -54,20 +64,10 @@ static uint64_t keyed_hash(const char *s, uint32_t length, uint64_t key[]) {
 
     // There may be some bytes left over, we should use them.
     if (length % (2 * sizeof(uint64_t)) != 0) {
-        speck_expand_key_and_encrypt(in.ll, out, key);
-        accum ^= out[0] ^ out[1];
+        speck_encrypt(in.ll, out, rk);
+        accum.lo ^= out[0];
+        accum.hi ^= out[1];
     }
 
     return accum;
 }
-
-uint32_t hash(uint64_t *salt, char *key) {
-    union {
-        uint64_t full;
-        uint32_t half[2];
-    } value;
-
-    value.full = keyed_hash(key, strlen(key), salt);
-
-    return value.half[0] ^ value.half[1];
-}
@@ -1,8 +1,14 @@
 #ifndef __SPECK_H__
 #define __SPECK_H__
 
+#include "hash.h"
+
 #include <stdint.h>
 
-uint32_t hash(uint64_t *salt, char *key);
+#define SPECK_ROUNDS 32
+
+void speck_expand_key(uint64_t K[], uint64_t rk[]);
+
+Digest speck_hash(const uint64_t rk[], const char *key, uint32_t length);
 
 #endif
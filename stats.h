@@ -0,0 +1,42 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <time.h>
+
+/* counters of a filter. lookups count into the Stats they are given (nowhere if it is NULL) */
+typedef struct Stats {
+    uint64_t seeks; // number of seeks performed
+    uint64_t links; // number of links traversed
+    uint64_t probes; // words probed in the bf
+    uint64_t passes; // words that passed the bf
+    uint64_t false_positives; // words that passed the bf but are not in the dictionary
+    uint64_t words; // words scanned (probes plus the ones too long to be in the dictionary)
+    uint64_t moves; // nodes moved to the front of their list (-m)
+    uint64_t normalized; // words found by their canonical form only (-n)
+    uint64_t tokenize_ns; // time spent scanning and lowercasing words (if timed)
+    uint64_t probe_ns; // time spent hashing, probing and looking them up (if timed)
+} Stats;
+
+/* adds the counters of from to to */
+static inline void stats_add(Stats *to, const Stats *from) {
+    to->seeks += from->seeks;
+    to->links += from->links;
+    to->probes += from->probes;
+    to->passes += from->passes;
+    to->false_positives += from->false_positives;
+    to->words += from->words;
+    to->moves += from->moves;
+    to->normalized += from->normalized;
+    to->tokenize_ns += from->tokenize_ns;
+    to->probe_ns += from->probe_ns;
+}
+
+/* returns the time of clock (e.g. CLOCK_MONOTONIC or CLOCK_PROCESS_CPUTIME_ID) in ns */
+static inline uint64_t stats_clock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+#
+# Generates unicode.h, the tables the word scanner (parser.c) uses for UTF-8
+# words, from the Unicode database Python ships with:
+#
+#     python3 unicode.py > unicode.h     (or: make tables)
+#
+# A code point is a word character if it is a letter, a mark, a decimal digit
+# or a connector (like _), and it is folded with Unicode simple case folding
+# (one code point to one). Both are two stage tables over planes 0 and 1:
+# the top bits of a code point pick a block, and equal blocks are stored once.
+# Above plane 1 only the CJK ideographs (planes 2 and 3) and the variation
+# selectors of plane 14 are word characters, and nothing folds.
+
+import sys
+import unicodedata
+
+LIMIT = 0x20000  # code points covered by the tables
+WORD_SHIFT = 7  # code points per block of the word table: 128 (16 bytes of bits)
+FOLD_SHIFT = 6  # code points per block of the fold table: 64 deltas
+
+
+def is_word(cp):
+    category = unicodedata.category(chr(cp))
+    return category[0] in "LM" or category in ("Nd", "Pc")
+
+
+def fold(cp):
+    if 0xD800 <= cp < 0xE000:
+        return cp  # surrogates are never decoded
+    ch = chr(cp)
+    folded = ch.casefold()  # full folding: its single code point results are the simple ones
+    if len(folded) == 1:
+        return ord(folded)
+    lower = ch.lower()  # where full folding expands (e.g. U+1E9E), simple folding is the lowercase
+    return ord(lower) if len(lower) == 1 else cp
+
+
+def stages(values, shift):
+    """splits values into blocks of 1 << shift, returns the block index of each and the blocks"""
+    size = 1 << shift
+    index, blocks, seen = [], [], {}
+    for i in range(0, len(values), size):
+        block = tuple(values[i : i + size])
+        if block not in seen:
+            seen[block] = len(blocks)
+            blocks.append(block)
+        index.append(seen[block])
+    return index, blocks
+
+
+def rows(items, per_line, fmt):
+    lines = []
+    for i in range(0, len(items), per_line):
+        lines.append("    " + ", ".join(fmt(x) for x in items[i : i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    out = sys.stdout
+
+    # what the C code assumes about the code points past the tables
+    for cp in range(LIMIT, 0x110000):
+        selector = 0xE0100 <= cp <= 0xE01EF
+        if cp >= 0x40000 and is_word(cp) != selector:
+            sys.exit("unexpected word character U+%04X" % cp)
+        if fold(cp) != cp:
+            sys.exit("unexpected folding of U+%04X" % cp)
+
+    words = [is_word(cp) for cp in range(LIMIT)]
+    deltas = [fold(cp) - cp for cp in range(LIMIT)]
+
+    word_index, word_blocks = stages(words, WORD_SHIFT)
+    fold_index, fold_blocks = stages(deltas, FOLD_SHIFT)
+    if len(word_blocks) > 256 or len(fold_blocks) > 256:
+        sys.exit("too many blocks for a uint8_t index")
+
+    # the bits of a word block, 8 code points per byte (lowest first)
+    word_bytes = []
+    for block in word_blocks:
+        for i in range(0, len(block), 8):
+            word_bytes.append(sum(1 << k for k, w in enumerate(block[i : i + 8]) if w))
+
+    out.write("#ifndef __UNICODE_H__\n#define __UNICODE_H__\n\n")
+    out.write("/* generated by unicode.py from Unicode %s, do not edit */\n\n" % unicodedata.unidata_version)
+    out.write("#include <stdint.h>\n\n")
+    out.write("#define UNICODE_LIMIT      0x%X // code points covered by the tables\n" % LIMIT)
+    out.write("#define UNICODE_WORD_SHIFT %d\n" % WORD_SHIFT)
+    out.write("#define UNICODE_FOLD_SHIFT %d\n\n" % FOLD_SHIFT)
+
+    out.write("/* block of each %d code points in unicode_word_bits */\n" % (1 << WORD_SHIFT))
+    out.write("static const uint8_t unicode_word_index[%d] = {\n" % len(word_index))
+    out.write(rows(word_index, 16, str) + "\n};\n\n")
+
+    out.write("/* 1 bit per code point of a block: 1 if it is a word character */\n")
+    out.write("static const uint8_t unicode_word_bits[%d] = {\n" % len(word_bytes))
+    out.write(rows(word_bytes, 16, lambda b: "0x%02x" % b) + "\n};\n\n")
+
+    out.write("/* block of each %d code points in unicode_fold_delta */\n" % (1 << FOLD_SHIFT))
+    out.write("static const uint8_t unicode_fold_index[%d] = {\n" % len(fold_index))
+    out.write(rows(fold_index, 16, str) + "\n};\n\n")
+
+    flat = [d for block in fold_blocks for d in block]
+    out.write("/* what to add to a code point to fold it */\n")
+    out.write("static const int32_t unicode_fold_delta[%d] = {\n" % len(flat))
+    out.write(rows(flat, 8, str) + "\n};\n\n")
+
+    out.write("#endif\n")
+
+
+if __name__ == "__main__":
+    main()